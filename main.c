@@ -27,41 +27,122 @@ SOFTWARE.
 #include <string.h>
 #include "mcc_generated_files/application_manager.h"
 #include "mcc_generated_files/sensors_handling.h"
+#include "mcc_generated_files/telemetry.h"
+#include "mcc_generated_files/streams.h"
+#include "mcc_generated_files/rules.h"
+#include "mcc_generated_files/mqtt/mqtt_rtt/mqtt_rtt.h"
+#include "mcc_generated_files/mqtt/mqtt_sn/mqtt_sn.h"
+#include "mcc_generated_files/utils/json_config.h"
 
-//This handles messages published from the MQTT server when subscribed
-void receivedFromCloud(uint8_t *topic, uint8_t *payload)
+enum { SENSOR_LIGHT, SENSOR_TEMP, SENSOR_CHANNELS };
+
+static telemetryChannel_t sensorChannels[SENSOR_CHANNELS] = {
+    [SENSOR_LIGHT] = {"Light", 0, CFG_LIGHT_DEADBAND, CFG_LIGHT_THRESHOLD},
+    [SENSOR_TEMP]  = {"Temp",  2, CFG_TEMP_DEADBAND,  CFG_TEMP_THRESHOLD},
+};
+
+static void sampleSensors(int32_t *values)
 {
-    char *toggleToken = "\"toggle\":";
-    char *subString;
+    values[SENSOR_LIGHT] = SENSORS_getLightValue();
+    values[SENSOR_TEMP] = SENSORS_getTempValue();
+}
 
-    if ((subString = strstr((char*)payload, toggleToken))) {
-        LED_holdYellowOn( subString[strlen(toggleToken)] == '1' );
-    }
+#if CFG_MQTT_SN
+static const mqttSnTopic_t sensorSnTopic = {CFG_MQTT_SN_TOPIC_ID, CFG_MQTT_SN_QOS};
+#endif
 
-    debug_printer(SEVERITY_NONE, LEVEL_NORMAL, "topic: %s", topic);
-    debug_printer(SEVERITY_NONE, LEVEL_NORMAL, "payload: %s", payload);
+// Light and temperature, published to the events topic (through the MQTT-SN gateway with CFG_MQTT_SN)
+static stream_t sensorStream = {
+    "", sampleSensors, sensorChannels, SENSOR_CHANNELS,
+    CFG_SEND_INTERVAL, CFG_PUBLISH_INTERVAL, CFG_TELEMETRY_ENCODING,
+#if CFG_MQTT_SN
+    &sensorSnTopic
+#endif
+};
+
+#if CFG_MQTT_RTT_TELEMETRY
+static telemetryChannel_t linkChannels[] = {
+    {"Rtt", 0, 0, TELEMETRY_NO_THRESHOLD},
+};
+
+static void sampleLink(int32_t *values)
+{
+    values[0] = MQTT_RTT_getStats(MQTT_RTT_PING)->ewmaMs;
 }
 
-// This will get called every CFG_SEND_INTERVAL second only while we have a valid Cloud connection
-void sendToCloud(void)
+// Broker round trip time (ms), published to events/link at a slow rate
+static stream_t linkStream = {
+    "/link", sampleLink, linkChannels, 1,
+    CFG_RTT_SAMPLE_INTERVAL, CFG_RTT_PUBLISH_INTERVAL, CFG_TELEMETRY_ENCODING
+};
+#endif
+
+static void setPublishInterval(int32_t seconds)
 {
-    static char json[70];
+    if ((seconds > 0) && (seconds <= UINT16_MAX)) {
+        TELEMETRY_setPublishInterval(&sensorStream.telemetry, seconds);
+    }
+}
+
+static void setLightDeadband(int32_t deadband)   { TELEMETRY_setDeadband(&sensorStream.telemetry, SENSOR_LIGHT, deadband); }
+static void setLightThreshold(int32_t threshold) { TELEMETRY_setThreshold(&sensorStream.telemetry, SENSOR_LIGHT, threshold); }
+static void setTempDeadband(int32_t deadband)    { TELEMETRY_setDeadband(&sensorStream.telemetry, SENSOR_TEMP, deadband); }
+static void setTempThreshold(int32_t threshold)  { TELEMETRY_setThreshold(&sensorStream.telemetry, SENSOR_TEMP, threshold); }
+
+// Outputs the local rules can drive
+static const ruleOutput_t ruleOutputs[] = {
+    {"led", LED_setYellow},
+};
 
-    int temp = SENSORS_getTempValue();
-    int light = SENSORS_getLightValue();
-    int len = sprintf(json, "{\"Light\":%d,\"Temp\":%d.%02d}",
-                                light, temp/100, abs(temp)%100);
+// One setter per slot of CFG_RULES_MAX
+static void setRule0(const char *rule) { RULES_set(0, rule); }
+static void setRule1(const char *rule) { RULES_set(1, rule); }
+static void setRule2(const char *rule) { RULES_set(2, rule); }
+static void setRule3(const char *rule) { RULES_set(3, rule); }
+
+// Settings accepted on the config topic, e.g. {"toggle":1,"interval":30,"Temp":{"deadband":0.5}}
+// and local rules (see rules.h), e.g. {"rules":{"0":"Light<500,2000,led=1"}}. A config
+// document is applied up to PAYLOAD_SIZE - 1 bytes: a larger one is dropped whole (logged
+// as "MQTT: publish dropped"), so send the rules in several documents if they do not fit.
+static const jsonConfigBinding_t configBindings[] = {
+    {"toggle",          JSON_CONFIG_BOOL, 0, {.setBool = LED_holdYellowOn}},
+    {"interval",        JSON_CONFIG_INT,  0, {.setInt = setPublishInterval}},
+    {"Light.deadband",  JSON_CONFIG_INT,  0, {.setInt = setLightDeadband}},
+    {"Light.threshold", JSON_CONFIG_INT,  0, {.setInt = setLightThreshold}},
+    {"Temp.deadband",   JSON_CONFIG_INT,  2, {.setInt = setTempDeadband}},
+    {"Temp.threshold",  JSON_CONFIG_INT,  2, {.setInt = setTempThreshold}},
+    {"rules.0",         JSON_CONFIG_STRING, 0, {.setString = setRule0}},
+    {"rules.1",         JSON_CONFIG_STRING, 0, {.setString = setRule1}},
+    {"rules.2",         JSON_CONFIG_STRING, 0, {.setString = setRule2}},
+    {"rules.3",         JSON_CONFIG_STRING, 0, {.setString = setRule3}},
+};
+
+//This handles messages published from the MQTT server when subscribed
+void receivedFromCloud(uint8_t *topic, uint8_t *payload)
+{
+    jsonConfigParser_t config;
 
-    if (len >0) {
-        CLOUD_publishData((uint8_t*)json, len);
-        LED_flashYellow();
+    JSON_CONFIG_begin(&config, configBindings, sizeof(configBindings) / sizeof(configBindings[0]));
+    JSON_CONFIG_feed(&config, (char*)payload, strlen((char*)payload));
+    if ((JSON_CONFIG_end(&config) < 0) && (payload[0] != '\0')) {
+        debug_printError("CONFIG: malformed payload");
     }
+
+    debug_printer(SEVERITY_NONE, LEVEL_NORMAL, "topic: %s", topic);
+    debug_printer(SEVERITY_NONE, LEVEL_NORMAL, "payload: %s", payload);
 }
 
 int main(void)
 {
     application_init();
 
+    // Reports due while the Cloud is unreachable are queued (or held, in battery mode)
+    STREAMS_register(&sensorStream);
+#if CFG_MQTT_RTT_TELEMETRY
+    STREAMS_register(&linkStream);
+#endif
+    RULES_init(ruleOutputs, sizeof(ruleOutputs) / sizeof(ruleOutputs[0]));
+
     while (1) {
         runScheduler();
     }
@@ -35,6 +35,11 @@ SOFTWARE.
 #include "cloud/crypto_client/cryptoauthlib_main.h"
 #include "cloud/crypto_client/crypto_client.h"
 #include "cloud/wifi_service.h"
+#include "time_service.h"
+#include "telemetry_queue.h"
+#include "duty_cycle.h"
+#include "power_save.h"
+#include "mqtt/mqtt_sn/mqtt_sn.h"
 #if CFG_ENABLE_CLI
 #include "cli/cli.h"
 #endif
@@ -74,6 +79,8 @@ void application_init(){
    CLI_setdeviceId(attDeviceID);
 #endif
    debug_init(attDeviceID);
+   TIME_init();
+   TELEMETRY_QUEUE_init();
 
    ENABLE_INTERRUPTS();
 
@@ -129,17 +136,24 @@ void application_init(){
    wifi_init(wifiConnectionStateChanged, mode);
 
    if (mode == WIFI_DEFAULT) {
-      CLOUD_init(attDeviceID);
-      timeout_create(&MAIN_dataTasksTimer, MAIN_DATATASK_INTERVAL);
+      application_post_provisioning();
    }
 
    LED_test();          // second LED sequence
 }
 
+// Start the cloud services, at boot or once SoftAP provisioning has completed
 void application_post_provisioning(void)
 {
 	CLOUD_init(attDeviceID);
+	POWER_SAVE_init();
 	timeout_create(&MAIN_dataTasksTimer, MAIN_DATATASK_INTERVAL);
+#if CFG_DUTY_CYCLE
+	DUTY_CYCLE_init();
+#endif
+#if CFG_MQTT_SN
+	MQTT_SN_init(attDeviceID);
+#endif
 }
 
 
@@ -158,41 +172,17 @@ void  wifiConnectionStateChanged(uint8_t status)
 // This scheduler will check all tasks and timers that are due and service them
 void runScheduler(void)
 {
+    wifi_handleEvents();
     timeout_next();
+#if CFG_DUTY_CYCLE
+    DUTY_CYCLE_idle();
+#endif
 }
 
 
-// This could be better done with a function pointer (DI) but in the interest of simplicity
-//     we avoided that. This is being called from MAIN_dataTask below
-void sendToCloud(void);
-
 // This gets called by the scheduler approximately every 100ms
 uint32_t MAIN_dataTask(void *payload)
 {
-//    static time_t previousTransmissionTime = 0;
-    static unsigned main_counter = 0;
-
-   // Get the current time. This uses the C standard library time functions
-   time_t timeNow = time(NULL);
-
-#define TASK_PERIOD_MULTIPLE   (CFG_SEND_INTERVAL*1000/MAIN_DATATASK_INTERVAL)
-// i.e. SEND_INTERVAL==1 sec, MAIN_DATATASK_INTERVAL==100ms -> PERIOD_MULTIPLE==10
-
-    if (CLOUD_isConnected()) {
-        // increment internal time keeper
-        main_counter++;
-        if (main_counter == (TASK_PERIOD_MULTIPLE)) {
-            main_counter = 0;
-            // update the system time
-            timeNow += CFG_SEND_INTERVAL;
-            set_system_time(timeNow);
-            sendToCloud();
-        }
-    }
-    else {
-        main_counter = 0;     // reset timer when not connected
-    }
-
    if (!shared_networking_params.haveAPConnection) {
         LED_BLUE_SetHigh();
     } else {
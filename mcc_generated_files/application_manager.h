@@ -43,7 +43,8 @@ typedef union
         unsigned amDisconnecting :1;
         unsigned haveAPConnection :1;
         unsigned haveERROR :1;
-        unsigned :5;
+        unsigned haveIPAddress :1;
+        unsigned :4;
     };
 } shared_networking_params_t;
 extern shared_networking_params_t shared_networking_params;
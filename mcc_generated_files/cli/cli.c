@@ -33,8 +33,20 @@
 #include "cli.h"
 #include "../cloud/wifi_service.h"
 #include "../cloud/cloud_service.h"
+#include "../cloud/broker_endpoints.h"
+#include "../cloud/bsd_adapter/bsdWINC.h"
+#include "../cloud/wifi_cache.h"
 #include "../cloud/crypto_client/crypto_client.h"
+#include "../winc/driver/source/nmspi.h"
 #include "../mqtt/mqtt_core/mqtt_core.h"
+#include "../mqtt/mqtt_rtt/mqtt_rtt.h"
+#include "../mqtt/mqtt_sn/mqtt_sn.h"
+#include "../time_service.h"
+#include "../telemetry_queue.h"
+#include "../streams.h"
+#include "../duty_cycle.h"
+#include "../power_save.h"
+#include "../rules.h"
 #include "../debug_print.h"
 #include "../mcc.h"
 
@@ -49,6 +61,19 @@
                         "version" NEWLINE\
                         "wifi <ssid>[,<pass>,[authType]]" NEWLINE\
                         "debug" NEWLINE\
+                        "tls" NEWLINE\
+                        "broker" NEWLINE\
+                        "rtt" NEWLINE\
+                        "time" NEWLINE\
+                        "queue" NEWLINE\
+                        "duty" NEWLINE\
+                        "rules" NEWLINE\
+                        "sockets" NEWLINE\
+                        "mqttsn" NEWLINE\
+                        "events" NEWLINE\
+                        "spi" NEWLINE\
+                        "power" NEWLINE\
+                        "ap" NEWLINE\
                         NEWLINE"\4"
 
 //                        "cli_version" NEWLINE
@@ -71,6 +96,19 @@ static void get_device_id(char *pArg);
 //static void get_cli_version(char *pArg);
 static void get_firmware_version(char *pArg);
 static void set_debug_level(char *pArg);
+static void get_tls_stats(char *pArg);
+static void get_broker_endpoints(char *pArg);
+static void get_rtt_stats(char *pArg);
+static void get_time_status(char *pArg);
+static void get_queue_stats(char *pArg);
+static void get_duty_cycle_stats(char *pArg);
+static void get_rules(char *pArg);
+static void get_socket_stats(char *pArg);
+static void get_mqtt_sn_stats(char *pArg);
+static void get_wifi_event_stats(char *pArg);
+static void get_spi_stats(char *pArg);
+static void get_power_save_stats(char *pArg);
+static void get_ap_stats(char *pArg);
 
 static bool endOfLineTest(char c);
 static void enableUsartRxInterrupts(void);
@@ -95,7 +133,20 @@ const struct cmd commands[] =
     { "device",      get_device_id },
 //    { "cli_version", get_cli_version },
     { "version",     get_firmware_version },
-    { "debug",       set_debug_level }
+    { "debug",       set_debug_level },
+    { "tls",         get_tls_stats },
+    { "broker",      get_broker_endpoints },
+    { "rtt",         get_rtt_stats },
+    { "time",        get_time_status },
+    { "queue",       get_queue_stats },
+    { "duty",        get_duty_cycle_stats },
+    { "rules",       get_rules },
+    { "sockets",     get_socket_stats },
+    { "mqttsn",      get_mqtt_sn_stats },
+    { "events",      get_wifi_event_stats },
+    { "spi",         get_spi_stats },
+    { "power",       get_power_save_stats },
+    { "ap",          get_ap_stats }
 };
 
 void CLI_init(void)
@@ -261,6 +312,236 @@ static void set_debug_level(char *pArg)
    }
 }
 
+static void print_handshake_stats(const char *name, const tlsHandshakeStats_t *stats)
+{
+    uint16_t average = stats->count ? (uint16_t)(stats->totalMs / stats->count) : 0;
+
+    printf("%s: %u, last %ums, avg %ums, max %ums\r\n", name, stats->count, stats->lastMs, average, stats->maxMs);
+}
+
+static void get_tls_stats(char *pArg)
+{
+    (void)pArg;
+    print_handshake_stats("full", CLOUD_getHandshakeStats(false));
+    print_handshake_stats("resumed", CLOUD_getHandshakeStats(true));
+    printf("\4");
+}
+
+static void get_broker_endpoints(char *pArg)
+{
+    uint8_t i;
+    (void)pArg;
+
+    for (i = 0; i < BROKER_count(); i++)
+    {
+        const brokerEndpoint_t *endpoint = BROKER_getEndpoint(i);
+        const brokerEndpointStats_t *stats = BROKER_getStats(i);
+
+        printf("%c%s:%u%s, %ums (resumed %ums), %u failures\r\n", (endpoint == BROKER_current()) ? '*' : ' ',
+                endpoint->host, endpoint->port, endpoint->tls ? " (TLS)" : "", stats->latencyMs, stats->resumedMs, stats->failures);
+    }
+    printf("\4");
+}
+
+static void print_rtt_stats(const char *name, const mqttRttStats_t *stats)
+{
+    uint8_t i;
+
+    printf("%s: %u, last %ums, avg %ums |", name, stats->samples, stats->lastMs, stats->ewmaMs);
+    for (i = 0; i < MQTT_RTT_BUCKETS; i++)
+    {
+        if (MQTT_RTT_getBucketLimit(i))
+        {
+            printf(" <%u:%u", MQTT_RTT_getBucketLimit(i), stats->histogram[i]);
+        }
+        else
+        {
+            printf(" more:%u", stats->histogram[i]);
+        }
+    }
+    printf("\r\n");
+}
+
+static void get_rtt_stats(char *pArg)
+{
+    (void)pArg;
+    print_rtt_stats("ping", MQTT_RTT_getStats(MQTT_RTT_PING));
+    print_rtt_stats("puback", MQTT_RTT_getStats(MQTT_RTT_PUBACK));
+    printf("\4");
+}
+
+static void get_time_status(char *pArg)
+{
+    uint16_t ms;
+    time_t now = TIME_now(&ms);
+    const timeServiceStats_t *stats = TIME_getStats();
+    (void)pArg;
+
+    printf("%lu.%03u, uptime %lums, drift %ldppm%s, error %ldms, interval %lus, samples %u, steps %u\r\n\4",
+            (uint32_t)now, ms, TIME_getMonotonicMs(), stats->driftPpm, stats->driftKnown ? "" : " (learning)",
+            stats->lastErrorMs, stats->syncIntervalS, stats->syncCount, stats->stepCount);
+}
+
+static void get_queue_stats(char *pArg)
+{
+    const telemetryQueueStats_t *stats = TELEMETRY_QUEUE_getStats();
+    (void)pArg;
+
+    printf("depth %u (ram %u, eeprom %u), queued %lu, spilled %lu, merged %lu, dropped %lu, replayed %lu, %u/min\r\n\4",
+            stats->ramDepth + stats->eepromDepth, stats->ramDepth, stats->eepromDepth, stats->queued,
+            stats->spilled, stats->merged, stats->dropped, stats->replayed, STREAMS_getReplayRate());
+}
+
+static void get_duty_cycle_stats(char *pArg)
+{
+    const dutyCycleStats_t *stats = DUTY_CYCLE_getStats();
+    (void)pArg;
+
+#if CFG_DUTY_CYCLE
+    printf("%s, cycles %u, failed %u, awake %lums (total %lus), asleep %lus, samples %lu, %luuJ/sample\r\n\4",
+            DUTY_CYCLE_isAsleep() ? "asleep" : "awake", stats->cycles, stats->failedWakes, stats->lastAwakeMs,
+            stats->totalAwakeMs / 1000, stats->totalAsleepMs / 1000, stats->lastSamples, stats->energyPerSampleUj);
+#else
+    (void)stats;
+    printf("Duty cycle off (CFG_DUTY_CYCLE)\r\n\4");
+#endif
+}
+
+static void print_actuation_stats(const char *name, const actuationStats_t *stats, const char *unit)
+{
+    printf("%s: %u, last %lu%s, max %lu%s, avg %lu%s\r\n", name, stats->count, stats->last, unit,
+            stats->max, unit, stats->count ? stats->total / stats->count : 0, unit);
+}
+
+static void get_rules(char *pArg)
+{
+    char rule[24];
+    uint8_t i;
+    (void)pArg;
+
+    for (i = 0; i < CFG_RULES_MAX; i++)
+    {
+        if (RULES_format(i, rule, sizeof(rule)))
+        {
+            printf("%u: %s\r\n", i, rule);
+        }
+    }
+    print_actuation_stats("local", RULES_getLocalStats(), "us");
+    // The broker part of any cloud actuation
+    printf("cloud: mqtt rtt ping %ums, puback %ums (see rtt)\r\n\4", MQTT_RTT_getStats(MQTT_RTT_PING)->ewmaMs,
+            MQTT_RTT_getStats(MQTT_RTT_PUBACK)->ewmaMs);
+}
+
+static void get_socket_stats(char *pArg)
+{
+    const bsdSocketStats_t *stats;
+    int i;
+    (void)pArg;
+
+    for (i = 0; (stats = BSD_getSocketStats(i)) != NULL; i++)
+    {
+        if ((BSD_GetSocketState(i) != NOT_A_SOCKET) || (stats->sends > 0) || (stats->bytesIn > 0))
+        {
+            printf("%d: state %d, in %lu, out %lu, acked %lu, sends %u, stalls %u, errors %u\r\n", i,
+                    BSD_GetSocketState(i), stats->bytesIn, stats->bytesOut, stats->bytesAcked, stats->sends,
+                    stats->stalls, stats->errors);
+            if (stats->receives > 0)
+            {
+                // The HIF transfer is the first copy of each byte received
+                uint32_t copies = 100 + stats->bytesCopied * 100 / stats->bytesIn;
+                uint16_t reads = (uint32_t)stats->hifReads * 10 / stats->receives;
+
+                printf("   %lu.%02lu copies/byte, %u receives, %u.%u hif reads/receive\r\n",
+                        copies / 100, copies % 100, stats->receives, reads / 10, reads % 10);
+            }
+        }
+    }
+    printf("\4");
+}
+
+static void get_mqtt_sn_stats(char *pArg)
+{
+    const mqttSnStats_t *stats = MQTT_SN_getStats();
+    (void)pArg;
+
+#if CFG_MQTT_SN
+    printf("%s, publishes %u, acked %u, lost %u, retries %u, connects %u, out %lu bytes\r\n\4",
+            MQTT_SN_isReady(MQTT_SN_QOS_NONE) ? "up" : "down", stats->publishes, stats->acked, stats->lost,
+            stats->retries, stats->connects, stats->bytesOut);
+#else
+    (void)stats;
+    printf("MQTT-SN off (CFG_MQTT_SN)\r\n\4");
+#endif
+}
+
+static void get_wifi_event_stats(char *pArg)
+{
+    const wifiEventStats_t *stats = wifi_getEventStats();
+    const wifiLatencyStats_t *latency = &stats->latency;
+    (void)pArg;
+
+    printf("%s, events %u, last %luus, max %luus, avg %luus, missed edges %u, polls %u (idle %u)\r\n\4",
+            CFG_WIFI_IRQ_EVENTS ? "irq" : "polled", latency->count, latency->last, latency->max,
+            latency->count ? latency->total / latency->count : 0, stats->missedEdges, stats->polls,
+            stats->idlePolls);
+}
+
+static uint32_t bytesPerMs(const tstrNmSpiBlockStats *stats)
+{
+    uint32_t ms = stats->u32Us / 1000;
+
+    return ms ? stats->u32Bytes / ms : 0;
+}
+
+static void get_spi_stats(char *pArg)
+{
+    const tstrNmSpiStats *stats = nm_spi_get_stats();
+    (void)pArg;
+
+    printf("%s, read %lu B in %u blocks, %lu kB/s, write %lu B in %u blocks, %lu kB/s\r\n",
+            CFG_WINC_SPI_BUFFERED ? "buffered" : "bytewise",
+            stats->strRead.u32Bytes, stats->strRead.u16Blocks, bytesPerMs(&stats->strRead),
+            stats->strWrite.u32Bytes, stats->strWrite.u16Blocks, bytesPerMs(&stats->strWrite));
+    printf("crc %s, register access avg %luus, bus errors %u, crc16 errors %u\r\n\4",
+            nm_spi_is_crc_on() ? "on" : "off",
+            stats->strReg.u32Bytes ? stats->strReg.u32Us / (stats->strReg.u32Bytes / 4) : 0,
+            stats->u16BusErrors, stats->u16Crc16Errors);
+}
+
+static void get_power_save_stats(char *pArg)
+{
+    const powerSaveStats_t *stats = POWER_SAVE_getStats();
+    (void)pArg;
+
+#if CFG_POWER_SAVE
+    printf("mode %u, listen interval %u, proactive wakes %u, ", stats->mode, stats->listenInterval,
+            stats->proactiveWakes);
+#else
+    printf("Power save off (CFG_POWER_SAVE), ");
+#endif
+    printf("wakes %u, avg %luus, max %luus, awake %lums/min (last %lums/min)\r\n\4", stats->wakes,
+            stats->wakeUsAvg, stats->wakeUsMax, stats->awakeMsPerMin, stats->lastAwakeMsPerMin);
+}
+
+static void get_ap_stats(char *pArg)
+{
+    const wifiConnectStats_t *stats = wifi_getConnectStats();
+    uint8_t channel;
+    (void)pArg;
+
+    printf("directed %u, fallbacks %u, scans %u, no DHCP %u, association %lums, to IP %lums (avg %lums)\r\n",
+            stats->directed, stats->fallbacks, stats->scans, stats->presetAddresses, stats->lastAssociationMs,
+            stats->lastAddressMs, stats->addresses ? stats->totalAddressMs / stats->addresses : 0);
+    if (WIFI_CACHE_getChannel(NULL, &channel))
+    {
+        printf("cached channel %u\r\n\4", channel);
+    }
+    else
+    {
+        printf("no cached channel\r\n\4");
+    }
+}
+
 static void get_public_key(char *pArg)
 {
     char key_pem_format[MAX_PUB_KEY_LEN];
@@ -0,0 +1,126 @@
+/*
+    \file   broker_endpoints.c
+
+    \brief  MQTT broker endpoint selection source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "broker_endpoints.h"
+#include "../config/mqtt_config.h"
+#include "../debug_print.h"
+
+#define ENDPOINT_COUNT  (sizeof(endpoints) / sizeof(*endpoints))
+
+static const brokerEndpoint_t endpoints[] = { CFG_MQTT_ENDPOINTS };
+static brokerEndpointStats_t endpointStats[ENDPOINT_COUNT];
+static uint8_t current = 0;
+
+// Expected connection cost in ms, 0 for an endpoint still to be probed
+static uint32_t endpointCost(uint8_t index)
+{
+   return endpointStats[index].latencyMs
+         + (uint32_t)endpointStats[index].failures * CFG_MQTT_ENDPOINT_FAILURE_PENALTY;
+}
+
+const brokerEndpoint_t *BROKER_select(void)
+{
+   uint8_t i;
+   uint8_t best = current;
+
+   for (i = 0; i < ENDPOINT_COUNT; i++)
+   {
+      if (endpointCost(i) < endpointCost(best))
+      {
+         best = i;
+      }
+   }
+
+   // Leave a working endpoint only for a clear (25%) gain, or to probe a new one
+   if ((best != current) && (endpointStats[current].failures == 0)
+         && (endpointCost(best) * 4 > endpointCost(current) * 3))
+   {
+      best = current;
+   }
+
+   if (best != current)
+   {
+      debug_printInfo("BROKER: %s:%u -> %s:%u", endpoints[current].host, endpoints[current].port,
+            endpoints[best].host, endpoints[best].port);
+      current = best;
+   }
+   return &endpoints[current];
+}
+
+const brokerEndpoint_t *BROKER_current(void)
+{
+   return &endpoints[current];
+}
+
+// Moving average of handshake durations, 0 means "not measured"
+static uint16_t average(uint16_t avg, uint32_t ms)
+{
+   if (ms > UINT16_MAX)
+   {
+      ms = UINT16_MAX;
+   }
+   else if (ms == 0)
+   {
+      ms = 1;
+   }
+   return (avg == 0) ? (uint16_t)ms : (uint16_t)((3UL * avg + ms) / 4);
+}
+
+void BROKER_reportHandshake(uint16_t ms, bool resumed)
+{
+   uint8_t i;
+   brokerEndpointStats_t *stats = &endpointStats[current];
+
+   if (!resumed)
+   {
+      stats->latencyMs = average(stats->latencyMs, ms);
+   }
+   else if ((stats->resumedMs != 0) && (stats->latencyMs != 0))
+   {
+      // A resumed handshake is not comparable with the full ones of the other
+      // endpoints: apply its change relative to the usual resumed time instead
+      stats->latencyMs = average(stats->latencyMs, (uint32_t)stats->latencyMs * ms / stats->resumedMs);
+   }
+   if (resumed)
+   {
+      stats->resumedMs = average(stats->resumedMs, ms);
+   }
+   stats->failures = 0;
+
+   // Let endpoints that failed in the past get another chance, eventually
+   for (i = 0; i < ENDPOINT_COUNT; i++)
+   {
+      endpointStats[i].failures >>= 1;
+   }
+}
+
+void BROKER_reportFailure(void)
+{
+   if (endpointStats[current].failures < UINT8_MAX)
+   {
+      endpointStats[current].failures++;
+   }
+   debug_printError("BROKER: %s:%u failed (%u)", endpoints[current].host, endpoints[current].port,
+         endpointStats[current].failures);
+}
+
+uint8_t BROKER_count(void)
+{
+   return ENDPOINT_COUNT;
+}
+
+const brokerEndpoint_t *BROKER_getEndpoint(uint8_t index)
+{
+   return (index < ENDPOINT_COUNT) ? &endpoints[index] : NULL;
+}
+
+const brokerEndpointStats_t *BROKER_getStats(uint8_t index)
+{
+   return (index < ENDPOINT_COUNT) ? &endpointStats[index] : NULL;
+}
@@ -0,0 +1,48 @@
+/*
+    \file   broker_endpoints.h
+
+    \brief  MQTT broker endpoint selection header file.
+
+    The endpoints listed in CFG_MQTT_ENDPOINTS are ranked by the duration of
+    their last full TLS handshakes, with a penalty for each failed connection.
+    Resumed handshakes with the current endpoint scale its full handshake
+    estimate by how much they slowed down (or sped up), so a degrading
+    endpoint is noticed between full handshakes.
+    Unmeasured endpoints are tried first, so every endpoint gets probed once.
+    The ranking is kept in RAM across reconnects.
+*/
+
+#ifndef BROKER_ENDPOINTS_H_
+#define BROKER_ENDPOINTS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+   const char *host;
+   uint16_t port;
+   bool tls;
+} brokerEndpoint_t;
+
+typedef struct
+{
+   uint16_t latencyMs;     // average full handshake duration, 0 until measured
+   uint16_t resumedMs;     // average resumed handshake duration, 0 until measured
+   uint8_t  failures;      // consecutive failed connections
+} brokerEndpointStats_t;
+
+// Pick the endpoint for the next connection and make it the current one
+const brokerEndpoint_t *BROKER_select(void);
+// Endpoint used by the current (or last) connection
+const brokerEndpoint_t *BROKER_current(void);
+// A full (or resumed) handshake with the current endpoint completed in ms
+void BROKER_reportHandshake(uint16_t ms, bool resumed);
+// The connection to the current endpoint could not be established
+void BROKER_reportFailure(void);
+
+uint8_t BROKER_count(void);
+const brokerEndpoint_t *BROKER_getEndpoint(uint8_t index);
+const brokerEndpointStats_t *BROKER_getStats(uint8_t index);
+
+#endif /* BROKER_ENDPOINTS_H_ */
@@ -36,7 +36,6 @@
 #include "../../winc/socket/include/socket.h"
 #include "../../debug_print.h"
 
-#define MAX_SUPPORTED_SOCKETS		2
 /**********************BSD (WINC) Enumerator Translators ********************************/
 typedef enum
 {
@@ -94,7 +93,10 @@ typedef struct {
 /**********************BSD (Private) Global Variables ********************************/
 static bsdErrno_t bsdErrorNumber;
 
-static packetReceptionHandler_t *packetRecvInfo;
+static bsdSocket_t bsdSockets[MAX_SOCKET];
+
+// Lands the bytes a full receive ring cannot take
+static uint8_t rxDiscard[16];
 
 /**********************BSD (Private) Function Prototypes *****************************/
 static void bsd_setErrNo (bsdErrno_t errorNumber);
@@ -111,25 +113,234 @@ bsdErrno_t BSD_GetErrNo(void)
 	return bsdErrorNumber;
 }
 
-packetReceptionHandler_t* getSocketInfo(uint8_t sock)
-{   
-   uint8_t i = 0;
-   if (sock >= 0)
+static uint16_t ringTail(const bsdRxRing_t *rx)
+{
+   return (rx->head + rx->count) % rx->size;
+}
+
+// Free space from the tail, up to the end of the buffer
+static uint16_t ringSpan(const bsdRxRing_t *rx)
+{
+   uint16_t tail = ringTail(rx);
+   uint16_t space = rx->size - rx->count;
+
+   return (tail + space > rx->size) ? rx->size - tail : space;
+}
+
+// Ask the WINC for more only with room for a receive of the usual size: it
+// sends up to a whole TCP segment per request, what the ring cannot take is lost
+static bool ringWants(const bsdRxRing_t *rx)
+{
+   return (rx->size - rx->count >= rx->window);
+}
+
+// Waiting bytes a reader may see: the ones before the lost bytes, if any
+static uint16_t ringReadable(const bsdRxRing_t *rx)
+{
+   return (rx->dropped > 0) ? rx->gapAt : rx->count;
+}
+
+static void ringReset(bsdRxRing_t *rx)
+{
+   rx->head = rx->count = rx->dropped = rx->gapAt = rx->firstEnd = 0;
+   rx->wanted = 1;
+   rx->window = rx->size / 2;
+   rx->armed = rx->inMessage = false;
+}
+
+// The window follows the largest recent receive: up at once, down slowly (1/8
+// of the way per receive), from half the ring to all of it
+static void ringAdapt(bsdRxRing_t *rx, uint16_t length)
+{
+   uint16_t window = rx->window;
+
+   if (length >= window)
+   {
+      window = length;
+   }
+   else
+   {
+      window -= (window - length) / 8;
+   }
+   if (window < rx->size / 2)
    {
-      packetReceptionHandler_t *bsdSocketInfo = BSD_GetRecvHandlerTable();
-      for(i = 0; i < MAX_SUPPORTED_SOCKETS; i++)
+      window = rx->size / 2;
+   }
+   rx->window = (window < rx->size) ? window : rx->size;
+}
+
+// Point the WINC at the free space of the ring, or at the discard buffer when
+// full. Requests more data unless a request is already outstanding.
+static void ringArm(int8_t sock, bsdRxRing_t *rx)
+{
+   uint16_t span = ringSpan(rx);
+
+   if (span > 0)
+   {
+      recv(sock, rx->buffer + ringTail(rx), span, 0);
+   }
+   else
+   {
+      recv(sock, rxDiscard, sizeof(rxDiscard), 0);
+   }
+   rx->armed = true;
+}
+
+// One chunk of a WINC receive, already in place at the ring tail
+static void ringReceived(int8_t sock, bsdSocket_t *bsdSocket, const tstrSocketRecvMsg *pstrRecv)
+{
+   bsdRxRing_t *rx = &bsdSocket->rx;
+
+   if (!rx->inMessage)
+   {
+      rx->inMessage = true;
+      rx->armed = false;      // the request is being answered
+      ringAdapt(rx, pstrRecv->s16BufferSize + pstrRecv->u16RemainingSize);
+      rx->lastAt = timeout_getTime();
+      if (rx->count == 0)
       {
-         if(bsdSocketInfo)
-         {
-            if(*(bsdSocketInfo->socket) == sock)
-            {
-               return bsdSocketInfo;
-            }
-         }
-         bsdSocketInfo++;
+         rx->firstAt = rx->lastAt;
+      }
+   }
+   if (pstrRecv->pu8Buffer == rxDiscard)
+   {
+      if (rx->dropped == 0)
+      {
+         rx->gapAt = rx->count;
+      }
+      else if (rx->gapAt != rx->count)
+      {
+         // A second gap: what arrived in between goes too, to make one of them
+         rx->dropped += rx->count - rx->gapAt;
+         rx->count = rx->gapAt;
+      }
+      rx->dropped += pstrRecv->s16BufferSize;
+      bsdSocket->stats.errors++;
+      debug_printError("BSD: socket (%d) ring full, %d bytes lost", sock, pstrRecv->s16BufferSize);
+   }
+   else
+   {
+      rx->count += pstrRecv->s16BufferSize;
+      // Received in the same tick as the first bytes, they are timed with them
+      if (rx->lastAt == rx->firstAt)
+      {
+         rx->firstEnd = rx->count;
       }
    }
-   return NULL;
+   if (pstrRecv->u16RemainingSize == 0)
+   {
+      rx->inMessage = false;
+      // Otherwise BSD_recv() asks, the WINC holds on to the data meanwhile
+      if (!rx->armed && !ringWants(rx))
+      {
+         return;
+      }
+   }
+   // The next chunk of this receive lands at the new tail
+   ringArm(sock, rx);
+}
+
+static bsdSocket_t *getSocketInfo(int sock)
+{
+   return ((sock >= 0) && (sock < MAX_SOCKET)) ? &bsdSockets[sock] : NULL;
+}
+
+// The WINC copies a send out of the caller's buffer right away but completes
+// it later: a credit is held until then
+static bool txCredit(int socket)
+{
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+
+   if (bsdSocket && (bsdSocket->tx.count == CFG_BSD_SEND_CREDITS))
+   {
+      bsdSocket->stats.stalls++;
+      bsd_setErrNo(EAGAIN);
+      return false;
+   }
+   return true;
+}
+
+// sent: the length, or BSD_ERROR if the WINC refused it
+static void countSend(int socket, int sent)
+{
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+   bsdTxQueue_t *tx;
+
+   if (bsdSocket == NULL)
+   {
+      return;
+   }
+   if (sent == BSD_ERROR)
+   {
+      bsdSocket->stats.errors++;
+      return;
+   }
+   bsdSocket->stats.sends++;
+   bsdSocket->stats.bytesOut += sent;
+   tx = &bsdSocket->tx;
+   tx->length[(tx->head + tx->count) % CFG_BSD_SEND_CREDITS] = sent;
+   tx->count++;
+}
+
+// SOCKET_MSG_SEND(TO): the WINC is done with the oldest send, sent is its count
+// of bytes sent or an error
+static void txCompleted(int8_t sock, bsdSocket_t *bsdSocket, int16_t sent)
+{
+   bsdTxQueue_t *tx = &bsdSocket->tx;
+   uint16_t length;
+
+   if (tx->count == 0)
+   {
+      debug_printError("BSD: socket (%d) unexpected send completion", sock);
+      return;
+   }
+   length = tx->length[tx->head];
+   tx->head = (tx->head + 1) % CFG_BSD_SEND_CREDITS;
+   tx->count--;
+   if (sent > 0)
+   {
+      bsdSocket->stats.bytesAcked += sent;
+   }
+   if (sent != (int16_t)length)
+   {
+      tx->failed = true;
+      bsdSocket->stats.errors++;
+      debug_printError("BSD: socket (%d) sent %d of %u bytes", sock, sent, length);
+   }
+}
+
+void BSD_reset(void)
+{
+   memset(bsdSockets, 0, sizeof(bsdSockets));
+}
+
+void BSD_setRecvCallback(int socket, bsdRecvFuncPtr callback)
+{
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+
+   if (bsdSocket)
+   {
+      bsdSocket->recvCallBack = callback;
+   }
+}
+
+void BSD_setRecvRing(int socket, uint8_t *buffer, uint16_t size)
+{
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+
+   if (bsdSocket)
+   {
+      bsdSocket->rx.buffer = buffer;
+      bsdSocket->rx.size = size;
+      ringReset(&bsdSocket->rx);
+   }
+}
+
+const bsdSocketStats_t *BSD_getSocketStats(int socket)
+{
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+
+   return bsdSocket ? &bsdSocket->stats : NULL;
 }
 
 int BSD_socket(int domain, int type, int protocol)
@@ -181,6 +392,8 @@ int BSD_socket(int domain, int type, int protocol)
 		return BSD_ERROR;
 	}       
    
+   memset(&bsdSockets[wincSocketReturn], 0, sizeof(bsdSocket_t));
+   bsdSockets[wincSocketReturn].socketState = SOCKET_CLOSED;
    return wincSocketReturn;		// >= 0 represents SUCCESS
 }
 
@@ -190,7 +403,7 @@ int BSD_connect(int socket, const struct bsd_sockaddr *name, socklen_t namelen)
 	wincSocketResponses_t wincConnectReturn = WINC_SOCK_ERR_INVALID;	
 	wincSupported_sockaddr winc_sockaddr;
 
-    packetReceptionHandler_t *bsdSocket = getSocketInfo(socket);
+    bsdSocket_t *bsdSocket = getSocketInfo(socket);
     if(!bsdSocket)
     {
         debug_printError("BSD: connect error unknown socket number");
@@ -235,7 +448,7 @@ int BSD_connect(int socket, const struct bsd_sockaddr *name, socklen_t namelen)
             }
             else
             {
-               debug_printGOOD("BSD: socket (%d) in progress",*bsdSocket->socket);
+               debug_printGOOD("BSD: socket (%d) in progress",socket);
                bsdSocket->socketState = SOCKET_IN_PROGRESS;
                returnValue = BSD_SUCCESS;
             }
@@ -248,20 +461,99 @@ int BSD_connect(int socket, const struct bsd_sockaddr *name, socklen_t namelen)
     return returnValue; 
 }
 
-void BSD_SetRecvHandlerTable(packetReceptionHandler_t *appRecvInfo)
+// A reader wants more than is waiting: ask for what fits, or it could wait
+// forever on a window the ring cannot free
+static int ringWaiting(int socket, bsdSocket_t *bsdSocket, uint16_t want)
 {
-	packetRecvInfo = appRecvInfo;
+   bsdRxRing_t *rx = &bsdSocket->rx;
+
+   rx->wanted = (want > 0) ? want : 1;
+   if ((rx->count < want) && !rx->armed && (rx->count < rx->size)
+         && (bsdSocket->socketState == SOCKET_CONNECTED))
+   {
+      ringArm(socket, rx);
+   }
+   if (ringReadable(rx) == 0)
+   {
+      if (bsdSocket->socketState != SOCKET_CONNECTED)
+      {
+         return 0;
+      }
+      bsd_setErrNo(EAGAIN);
+      return BSD_ERROR;
+   }
+   return ringReadable(rx);
 }
 
-packetReceptionHandler_t *BSD_GetRecvHandlerTable()
+static void ringConsume(int socket, bsdRxRing_t *rx, uint16_t count)
 {
-	return packetRecvInfo;
+   rx->head = (rx->head + count) % rx->size;
+   rx->count -= count;
+   rx->wanted = 1;             // what the reader needed was there
+   if (rx->dropped > 0)
+   {
+      rx->gapAt -= count;
+   }
+   if (count < rx->firstEnd)
+   {
+      rx->firstEnd -= count;
+   }
+   else
+   {
+      // The bytes left were in by the last receive
+      rx->firstEnd = rx->count;
+      rx->firstAt = rx->lastAt;
+   }
+   if (rx->count == 0)
+   {
+      rx->head = 0;           // the whole ring is contiguous again
+   }
+   if (rx->armed || ringWants(rx))
+   {
+      ringArm(socket, rx);
+   }
+}
+
+static int ringRecv(int socket, bsdSocket_t *bsdSocket, void *buf, size_t len, int flags)
+{
+   bsdRxRing_t *rx = &bsdSocket->rx;
+   int waiting = ringWaiting(socket, bsdSocket, (len < rx->size) ? len : rx->size);
+   uint16_t count;
+   uint16_t first = rx->size - rx->head;
+
+   if (waiting <= 0)
+   {
+      return waiting;
+   }
+   count = (len < (size_t)waiting) ? len : (uint16_t)waiting;
+   if (first > count)
+   {
+      first = count;
+   }
+   memcpy(buf, rx->buffer + rx->head, first);
+   memcpy((uint8_t *)buf + first, rx->buffer, count - first);
+   bsdSocket->stats.bytesCopied += count;
+   if (!(flags & BSD_MSG_PEEK))
+   {
+      ringConsume(socket, rx, count);
+   }
+   return count;
 }
 
-int BSD_recv(int socket, const void *buf, size_t len, int flags)
+int BSD_recv(int socket, void *buf, size_t len, int flags)
 {
     wincSocketResponses_t wincRecvReturn;
-	
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+
+   if (bsdSocket && bsdSocket->rx.buffer)
+   {
+      if ((flags & ~BSD_MSG_PEEK) || (buf == NULL))
+      {
+         bsd_setErrNo(EINVAL);
+         return BSD_ERROR;
+      }
+      return ringRecv(socket, bsdSocket, buf, len, flags);
+   }
 	if (flags != 0)
 	{	// Flag Not Support by WINC implementation
 		bsd_setErrNo(EINVAL);
@@ -316,15 +608,98 @@ int BSD_recv(int socket, const void *buf, size_t len, int flags)
 	}
 }
 
+int BSD_recvInPlace(int socket, uint8_t **data, uint16_t want)
+{
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+   int waiting;
+
+   if (!bsdSocket || !bsdSocket->rx.buffer || (data == NULL))
+   {
+      bsd_setErrNo(EINVAL);
+      return BSD_ERROR;
+   }
+   waiting = ringWaiting(socket, bsdSocket, (want < bsdSocket->rx.size) ? want : bsdSocket->rx.size);
+   *data = bsdSocket->rx.buffer + bsdSocket->rx.head;
+   return waiting;
+}
+
+int BSD_recvRelease(int socket, uint16_t count)
+{
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+
+   if (!bsdSocket || !bsdSocket->rx.buffer || (count > ringReadable(&bsdSocket->rx)))
+   {
+      bsd_setErrNo(EINVAL);
+      return BSD_ERROR;
+   }
+   ringConsume(socket, &bsdSocket->rx, count);
+   return BSD_SUCCESS;
+}
+
+static uint16_t ringSkip(int socket, bsdRxRing_t *rx, uint32_t count)
+{
+   uint16_t skip = ringReadable(rx);
+
+   if (skip > count)
+   {
+      skip = count;
+   }
+   if (skip > 0)
+   {
+      ringConsume(socket, rx, skip);
+   }
+   return skip;
+}
+
+uint32_t BSD_recvSkip(int socket, uint32_t count)
+{
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+   bsdRxRing_t *rx;
+   uint32_t skipped;
+
+   if (!bsdSocket || !bsdSocket->rx.buffer)
+   {
+      return 0;
+   }
+   rx = &bsdSocket->rx;
+   // The bytes before the gap, the gap, then the bytes received after it
+   skipped = ringSkip(socket, rx, count);
+   if ((rx->dropped > 0) && (rx->gapAt == 0) && (skipped < count))
+   {
+      uint32_t skip = (count - skipped < rx->dropped) ? count - skipped : rx->dropped;
+
+      rx->dropped -= skip;
+      skipped += skip;
+      if (rx->dropped == 0)
+      {
+         skipped += ringSkip(socket, rx, count - skipped);
+      }
+   }
+   return skipped;
+}
+
+ticks BSD_recvTime(int socket, uint16_t count)
+{
+   bsdSocket_t *bsdSocket = getSocketInfo(socket);
+
+   if (!bsdSocket || !bsdSocket->rx.buffer)
+   {
+      return timeout_getTime();
+   }
+   return (count <= bsdSocket->rx.firstEnd) ? bsdSocket->rx.firstAt : bsdSocket->rx.lastAt;
+}
+
 int BSD_close(int socket)
 {
    wincSocketResponses_t wincCloseReturn;
    
    debug_printGOOD("BSD: BSD_close (%d) ",socket);
-   packetReceptionHandler_t* sock = getSocketInfo(socket);
+   bsdSocket_t* sock = getSocketInfo(socket);
    if (sock != NULL)
    {
       sock->socketState = NOT_A_SOCKET;
+      ringReset(&sock->rx);
+      memset(&sock->tx, 0, sizeof(bsdTxQueue_t));
    }
     
    wincCloseReturn = close((SOCKET)socket);
@@ -569,27 +944,35 @@ int BSD_setsockopt(int socket, int level, int optname, const void *optval, sockl
 	wincSupportedSockLevel wincSockLevel;
 	wincSupportedSockOptions wincSockOptions;
 	
-	switch((wincSupportedSockLevel)level)
+	switch((bsdSockLevel_t)level)
 	{
-		case WINC_SOL_SOCKET:
-		case WINC_SOL_SSL_SOCKET:
-			wincSockLevel = level;
+		case BSD_SOL_SOCKET:
+			wincSockLevel = WINC_SOL_SOCKET;
+		break;
+		case BSD_SOL_SSL_SOCKET:
+			wincSockLevel = WINC_SOL_SSL_SOCKET;
 		break;
 		default:
 			bsd_setErrNo(EIO);
 		return BSD_ERROR;
 		
 	}
-	switch((wincSupportedSockOptions)optname)
+	switch((bsdSockOptions_t)optname)
 	{
-		case WINC_SO_SSL_BYPASS_X509_VERIF:
-		case WINC_SO_SSL_SNI:
-		case WINC_SO_SSL_ENABLE_SESSION_CACHING:
-		case WINC_SO_SSL_ENABLE_SNI_VALIDATION:
-			wincSockOptions = optname;
+		case BSD_SO_SSL_BYPASS_X509_VERIF:
+			wincSockOptions = WINC_SO_SSL_BYPASS_X509_VERIF;
+		break;
+		case BSD_SO_SSL_SNI:
+			wincSockOptions = WINC_SO_SSL_SNI;
+		break;
+		case BSD_SO_SSL_ENABLE_SESSION_CACHING:
+			wincSockOptions = WINC_SO_SSL_ENABLE_SESSION_CACHING;
+		break;
+		case BSD_SO_SSL_ENABLE_SNI_VALIDATION:
+			wincSockOptions = WINC_SO_SSL_ENABLE_SNI_VALIDATION;
 		break;	
 		default:
-			bsd_setErrNo(EIO);
+			bsd_setErrNo(ENOPROTOOPT);
 		return BSD_ERROR;
 	}
     wincSockOptResponse = setsockopt((SOCKET)socket, (uint8_t) wincSockLevel, (uint8_t) wincSockOptions, optval, (uint16_t)optlen);
@@ -627,26 +1010,57 @@ int BSD_setsockopt(int socket, int level, int optname, const void *optval, sockl
 
 int BSD_write(int fd, const void *buf, size_t nbytes)
 {
-	bsd_setErrNo(ENOSYS);
-	return BSD_ERROR;
+   return BSD_send(fd, buf, nbytes, 0);
 }
 
 int BSD_read(int fd, void *buf, size_t nbytes)
 {
-	bsd_setErrNo(ENOSYS);
-	return BSD_ERROR;
+   return BSD_recv(fd, buf, nbytes, 0);
 }
 
 int BSD_poll(struct pollfd *ufds, unsigned int nfds, int timeout)
 {
-	bsd_setErrNo(ENOSYS);
-	return BSD_ERROR;
+   unsigned int i;
+   int ready = 0;
+
+   for (i = 0; i < nfds; i++)
+   {
+      bsdSocket_t *bsdSocket = getSocketInfo(ufds[i].fd);
+
+      ufds[i].revents = 0;
+      if ((bsdSocket == NULL) || (bsdSocket->socketState == NOT_A_SOCKET))
+      {
+         ufds[i].revents = POLLNVAL;
+      }
+      else
+      {
+         if (ringReadable(&bsdSocket->rx) > 0)
+         {
+            ufds[i].revents |= POLLIN;
+         }
+         if ((bsdSocket->socketState == SOCKET_CONNECTED) && (bsdSocket->tx.count < CFG_BSD_SEND_CREDITS))
+         {
+            ufds[i].revents |= POLLOUT;
+         }
+         ufds[i].revents &= ufds[i].events;
+         // Lost bytes are an error once they stand in the way of a reader
+         if (bsdSocket->tx.failed || ((bsdSocket->rx.dropped > 0) && (bsdSocket->rx.gapAt < bsdSocket->rx.wanted)))
+         {
+            ufds[i].revents |= POLLERR;
+         }
+      }
+      if (ufds[i].revents)
+      {
+         ready++;
+      }
+   }
+   return ready;
 }
 
 socketState_t BSD_GetSocketState(int sock)
 {
 	socketState_t sockState;
-	packetReceptionHandler_t *bsdSocketInfo;
+	bsdSocket_t *bsdSocketInfo;
 
 	sockState = NOT_A_SOCKET;
 	bsdSocketInfo = getSocketInfo(sock);
@@ -668,7 +1082,11 @@ int BSD_send(int socket, const void *msg, size_t len, int flags)
       bsd_setErrNo(EINVAL);
       return BSD_ERROR;
    }
-   
+   if (!txCredit(socket))
+   {
+      return BSD_ERROR;
+   }
+
    wincSendReturn = send((SOCKET)socket, (void*)msg, (uint16_t)len, (uint16_t)flags);
    if(wincSendReturn != WINC_SOCK_ERR_NO_ERROR)
    {
@@ -700,6 +1118,7 @@ int BSD_send(int socket, const void *msg, size_t len, int flags)
          default:
          break;
       }
+      countSend(socket, BSD_ERROR);
       return BSD_ERROR;
    }
    else
@@ -709,6 +1128,7 @@ int BSD_send(int socket, const void *msg, size_t len, int flags)
       // successfully send the packet, 'len' number of bytes will
       // be transmitted. In this case, it is safe to return the
       // value of 'len' as the number of bytes sent.
+      countSend(socket, len);
       return len;
    }
 }
@@ -724,6 +1144,11 @@ int BSD_sendto(int socket, const void *msg, size_t len,	int flags, const struct
 		return BSD_ERROR;		
 	} 
 	
+	if (!txCredit(socket))
+	{
+		return BSD_ERROR;
+	}
+
 	winc_sockaddr.sa_family = to->sa_family;
 	memcpy((void*)winc_sockaddr.sa_data, (const void *)to->sa_data, sizeof(winc_sockaddr.sa_data));
 	
@@ -768,6 +1193,7 @@ int BSD_sendto(int socket, const void *msg, size_t len,	int flags, const struct
 			default:
 			break;
 		}
+		countSend(socket, BSD_ERROR);
 		return BSD_ERROR;
 	}
 	else
@@ -777,13 +1203,14 @@ int BSD_sendto(int socket, const void *msg, size_t len,	int flags, const struct
 		// successfully send the packet, 'len' number of bytes will
 		// be transmitted. In this case, it is safe to return the
 		// value of 'len' as the number of bytes sent.
+		countSend(socket, len);
 		return len;
 	}
 }
 
 void BSD_SocketHandler(int8_t sock, uint8_t msgType, void *pMsg)
 {
-	packetReceptionHandler_t *bsdSocketInfo;
+	bsdSocket_t *bsdSocketInfo;
 
 	bsdSocketInfo = getSocketInfo(sock);
    if(bsdSocketInfo == NULL) {
@@ -801,16 +1228,40 @@ void BSD_SocketHandler(int8_t sock, uint8_t msgType, void *pMsg)
             {
                debug_printGOOD("BSD: MSG_CONNECT successful");
                bsdSocketInfo->socketState = SOCKET_CONNECTED;
+               if (bsdSocketInfo->rx.buffer)
+               {
+                  ringReset(&bsdSocketInfo->rx);
+                  ringArm(sock, &bsdSocketInfo->rx);
+               }
             }
             else
             {
                debug_printError("BSD: Closing Socket in MSG_CONNECT error (%d)",pstrConnect->s8Error);
+               bsdSocketInfo->stats.errors++;
                BSD_close(sock);
             }
          }
 		break;
 
+		case SOCKET_MSG_BIND:
+         // A bound UDP socket can receive
+         if (pMsg && (((tstrSocketBindMsg *)pMsg)->status == 0))
+         {
+            bsdSocketInfo->socketState = SOCKET_CONNECTED;
+         }
+         else
+         {
+            debug_printError("BSD: socket (%d) bind failed", sock);
+            bsdSocketInfo->stats.errors++;
+         }
+		break;
+
 		case SOCKET_MSG_SEND:
+		case SOCKET_MSG_SENDTO:
+         if (pMsg)
+         {
+            txCompleted(sock, bsdSocketInfo, *(int16_t *)pMsg);
+         }
 		   bsdSocketInfo->socketState = SOCKET_CONNECTED;
 		break;
 
@@ -820,11 +1271,28 @@ void BSD_SocketHandler(int8_t sock, uint8_t msgType, void *pMsg)
           	tstrSocketRecvMsg *pstrRecv = (tstrSocketRecvMsg *)pMsg;
             if (pstrRecv->s16BufferSize > 0) 
             {
-	            bsdSocketInfo->recvCallBack(pstrRecv->pu8Buffer, pstrRecv->s16BufferSize);
+               bsdSocketInfo->stats.bytesIn += pstrRecv->s16BufferSize;
+               bsdSocketInfo->stats.hifReads++;
+               if (pstrRecv->u16RemainingSize == 0)
+               {
+                  bsdSocketInfo->stats.receives++;
+               }
+               if (bsdSocketInfo->rx.buffer)
+               {
+                  ringReceived(sock, bsdSocketInfo, pstrRecv);
+               }
+               else if (bsdSocketInfo->recvCallBack)
+               {
+                  bsdSocketInfo->recvCallBack(pstrRecv->pu8Buffer, pstrRecv->s16BufferSize);
+               }
 	            bsdSocketInfo->socketState = SOCKET_CONNECTED;
 							   
             } else {
                debug_printError("BSD: SOCKET (%d) CLOSED", sock);
+               if (pstrRecv->s16BufferSize < 0)
+               {
+                  bsdSocketInfo->stats.errors++;
+               }
                BSD_close(sock);  
             }                                
          }
@@ -837,7 +1305,11 @@ void BSD_SocketHandler(int8_t sock, uint8_t msgType, void *pMsg)
 			   tstrSocketRecvMsg *pstrRecv = (tstrSocketRecvMsg *)pMsg;
 			   if (pstrRecv->pu8Buffer && pstrRecv->s16BufferSize)
 			   {
-				   bsdSocketInfo->recvCallBack(pstrRecv->pu8Buffer, pstrRecv->s16BufferSize);
+               bsdSocketInfo->stats.bytesIn += pstrRecv->s16BufferSize;
+               if (bsdSocketInfo->recvCallBack)
+               {
+				      bsdSocketInfo->recvCallBack(pstrRecv->pu8Buffer, pstrRecv->s16BufferSize);
+               }
 				   bsdSocketInfo->socketState = SOCKET_CONNECTED;
 			   }  else {
                debug_printError("BSD: SOCKET (%d) CLOSED", sock);
@@ -33,11 +33,22 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include "../../config/IoT_Sensor_Node_config.h"
+#include "../../drivers/timeout.h"
 
 /***************** BSD Generic Defines **********************/
 #define		BSD_SUCCESS		0
 #define		BSD_ERROR		-1
 
+// Flags accepted by BSD_recv()
+#define		BSD_MSG_PEEK	0x02	// copy the data without consuming it
+
+// BSD_poll() events
+#define		POLLIN			0x0001	// data waiting in the receive ring
+#define		POLLOUT			0x0004	// connected, a send credit is free
+#define		POLLERR			0x0008	// a reader reached lost bytes, or a send failed (always reported)
+#define		POLLNVAL		0x0020	// not an open socket (always reported)
+
 /************* (END) BSD Generic Defines (END) *****************/
 
 /***************** BSD Type Defined Enumerators **********************/
@@ -77,6 +88,24 @@ typedef enum
 	BSD_SOCK_PACKET,
 }bsdTypes_t;
 
+// Option levels accepted by BSD_setsockopt()
+typedef enum
+{
+	BSD_SOL_SOCKET = 1,
+	BSD_SOL_SSL_SOCKET,
+}bsdSockLevel_t;
+
+// Options accepted by BSD_setsockopt() at BSD_SOL_SSL_SOCKET level
+// optval points to an int (0 = disable, 1 = enable), except for BSD_SO_SSL_SNI
+// which takes the server name string
+typedef enum
+{
+	BSD_SO_SSL_BYPASS_X509_VERIF = 1,
+	BSD_SO_SSL_SNI,
+	BSD_SO_SSL_ENABLE_SESSION_CACHING,
+	BSD_SO_SSL_ENABLE_SNI_VALIDATION,
+}bsdSockOptions_t;
+
 /************** (END) BSD Type Defined Enumerators (END) *******************/
 
 /***************** Error Number Defined Enumerators **********************/
@@ -222,24 +251,80 @@ struct pollfd {
  **/
 typedef void (*bsdRecvFuncPtr)(uint8_t *data, uint8_t length); 
 
-// The call back table prototype for sending the packet received over a socket
-// to the correct reception handler function defined in the user application.
-// An instance of this table needs to be initialized by the user application to 
-// to specify the recv callback function for each socket. 
+// Optional receive ring of a TCP socket (see BSD_setRecvRing()): the WINC
+// delivers straight into its free space and the data is read with BSD_recv(),
+// or in place with BSD_recvInPlace(), instead of being passed to recvCallBack.
+// The WINC is asked for more once window bytes are free, window following the
+// size of its recent receives: a receive then lands in one or two HIF reads.
+// A receive larger than the free space loses its end: readers see the bytes
+// up to the gap only, until BSD_recvSkip() throws the lost ones away.
+// Receives are timed as the WINC delivers them: the first firstEnd waiting
+// bytes were all in by firstAt, the rest by lastAt.
+typedef struct
+{
+   uint8_t *buffer;
+   uint16_t size;
+   uint16_t head;              // oldest byte
+   uint16_t count;
+   uint16_t window;
+   uint32_t dropped;           // bytes lost to a full ring, after the first gapAt waiting ones
+   uint16_t gapAt;
+   uint16_t wanted;            // the last amount a reader asked for
+   uint16_t firstEnd;
+   ticks firstAt;              // timeout_getTime()
+   ticks lastAt;
+   bool armed;                 // a WINC receive request is outstanding
+   bool inMessage;             // between the chunks of one WINC receive
+} bsdRxRing_t;
+
+// Sends the WINC took and has not completed yet (SOCKET_MSG_SEND), oldest
+// first. Each one holds a credit: without one BSD_send() fails with EAGAIN.
+typedef struct
+{
+   uint16_t length[CFG_BSD_SEND_CREDITS];
+   uint8_t head;
+   uint8_t count;
+   bool failed;                // a send completed short: the stream is broken
+} bsdTxQueue_t;
+
+typedef struct
+{
+   uint32_t bytesIn;
+   uint32_t bytesOut;
+   uint32_t bytesAcked;        // completed by the WINC
+   uint32_t bytesCopied;       // out of the receive ring by BSD_recv(), peeks included
+   uint16_t sends;
+   uint16_t receives;          // WINC receive messages (a TCP segment, a TLS record)
+   uint16_t hifReads;          // the HIF transfers they took, one per callback
+   uint16_t stalls;            // sends refused for want of a credit
+   uint16_t errors;            // failed sends, receive errors and overruns
+} bsdSocketStats_t;
+
+// One entry per WINC socket, indexed by the socket number: cleared by
+// BSD_socket(), kept after BSD_close() for the statistics
 typedef struct
 {
-   int8_t *socket;
-   bsdRecvFuncPtr recvCallBack;
 	socketState_t socketState;
-} packetReceptionHandler_t;
+   bsdRecvFuncPtr recvCallBack;
+   bsdRxRing_t rx;
+   bsdTxQueue_t tx;
+   bsdSocketStats_t stats;
+} bsdSocket_t;
 
 
 /*********************** (END) BSD Adapter definitions (END) **************************/
 
 /***************** BSD Public Functions **************************************/
-void BSD_SetRecvHandlerTable(packetReceptionHandler_t *appRecvInfo);
+// Forget all sockets, once the WINC socket layer is initialized
+void BSD_reset(void);
+
+// Receive path of a socket from BSD_socket(): each received chunk is passed to
+// callback, or with a ring it is kept there for BSD_recv()
+void BSD_setRecvCallback(int socket, bsdRecvFuncPtr callback);
+void BSD_setRecvRing(int socket, uint8_t *buffer, uint16_t size);
 
-packetReceptionHandler_t *BSD_GetRecvHandlerTable();
+// NULL if socket is not a WINC socket number
+const bsdSocketStats_t *BSD_getSocketStats(int socket);
 
 bsdErrno_t BSD_GetErrNo(void);
 
@@ -247,9 +332,26 @@ int BSD_socket(int domain, int type, int protocol);
 
 int BSD_connect(int socket, const struct bsd_sockaddr *name, socklen_t namelen);
 
+// The whole message or BSD_ERROR: EAGAIN while CFG_BSD_SEND_CREDITS sends are
+// in flight (try again later, see POLLOUT), ENOBUFS if the WINC refused it
 int BSD_send(int socket, const void *msg, size_t len, int flags);
 
-int BSD_recv(int socket, const void *msg, size_t len, int flags);
+// Ring sockets: the bytes read (up to len) without blocking, 0 once closed,
+// BSD_ERROR with EAGAIN if nothing is waiting
+int BSD_recv(int socket, void *buf, size_t len, int flags);
+
+// Ring sockets, without copying: points *data at the oldest byte and returns
+// how many are waiting (they wrap from the end of the ring to its start), as
+// BSD_recv() otherwise. Fewer than want: the WINC is asked for more. The bytes
+// stay in the ring until BSD_recvRelease().
+int BSD_recvInPlace(int socket, uint8_t **data, uint16_t want);
+int BSD_recvRelease(int socket, uint16_t count);
+// Ring sockets: throw away up to count bytes of the stream, the lost ones
+// included. Returns how many were thrown away.
+uint32_t BSD_recvSkip(int socket, uint32_t count);
+// Ring sockets: when (timeout_getTime()) the first count waiting bytes had all
+// been received, however long they waited to be read
+ticks BSD_recvTime(int socket, uint16_t count);
 
 int BSD_close(int socket);
 
@@ -277,14 +379,14 @@ int BSD_write(int fd, const void *buf, size_t nbytes);
 
 int BSD_read(int fd, void *buf, size_t nbytes);
 
+// Never blocks (the caller is a scheduler task): timeout is ignored
 int BSD_poll(struct pollfd *ufds, unsigned int nfds, int timeout);
 
 int BSD_sendto(int socket, const void *msg, size_t len,	int flags, const struct bsd_sockaddr *to, socklen_t tolen);
 
 void BSD_SocketHandler(int8_t sock, uint8_t msgType, void *pMsg);
 
-// ToDo This is not a true BSD_poll(). The actual BSD_poll() requires a 
-// structures and returns values which are not currently supported by WINC1500.
+// Connection state, see BSD_poll() for data and errors
 socketState_t BSD_GetSocketState(int sock);
 
 /************ (END) BSD Public Functions (END) *********************************/
@@ -48,7 +48,11 @@
 #include "../drivers/timeout.h"
 #include "mqtt_packetPopulation/mqtt_packetPopulate.h"
 #include "../mqtt/mqtt_core/mqtt_core.h"
+#include "../mqtt/mqtt_sn/mqtt_sn.h"
 #include "wifi_service.h"
+#include "dns_cache.h"
+#include "broker_endpoints.h"
+#include "../utils/text_writer.h"
 
 #include "../led.h"
 #include "../mqtt/mqtt_packetTransfer_interface.h"
@@ -56,6 +60,19 @@
 
 static bool cloudInitialized = false;
 static bool waitingForMQTT = false;
+// The broker address came from the EEPROM cache and no lookup has confirmed it yet
+static bool usingCachedIP = false;
+// A connection to the broker was attempted since the last reset
+static bool connectAttempted = false;
+
+// The WINC keeps the last TLS session until it is reset, so a reconnect after a
+// successful handshake offers it to the broker. The WINC does not report whether
+// the broker accepted it: a handshake is counted as resumed when a session was offered.
+static bool tlsSessionCached = false;
+static bool handshakePending = false;
+static bool handshakeResumed;
+static ticks handshakeStart;
+static tlsHandshakeStats_t handshakeStats[2];
 
 const char projectId[] = CFG_PROJECT_ID;
 const char projectRegion[] = CFG_PROJECT_REGION;
@@ -69,6 +86,8 @@ uint32_t mqttTimeoutTask(void *payload);
 uint32_t cloudResetTask(void *payload);
 
 static void dnsHandler(uint8_t * domainName, uint32_t serverIP);
+static void socketHandler(SOCKET sock, uint8_t msgType, void *pMsg);
+static void selectEndpoint(void);
 static void updateJWT(uint32_t epoch);
 
 static int8_t connectMQTTSocket(void);
@@ -105,8 +124,6 @@ publishReceptionHandler_t imqtt_publishReceiveCallBackTable[NUM_TOPICS_SUBSCRIBE
 
 uint32_t mqttGoogleApisComIP;
 
-packetReceptionHandler_t cloud_packetReceiveCallBackTable[CLOUD_PACKET_RECV_TABLE_SIZE];
-
 void CLOUD_reset(void)
 {
    debug_printError("CLOUD: Cloud Reset");
@@ -115,6 +132,17 @@ void CLOUD_reset(void)
 
 uint32_t mqttTimeoutTask(void *payload) {
    debug_printError("CLOUD: MQTT Connection Timeout");
+   if (connectAttempted && (BSD_GetSocketState(*MQTT_GetClientConnectionInfo()->tcpClientSocket) != SOCKET_CONNECTED))
+   {
+      // The broker never answered: rank it down, the reset will pick the next endpoint
+      BROKER_reportFailure();
+      if (usingCachedIP)
+      {
+         // The cached address never answered: drop it and wait for the lookup after the reset
+         DNS_CACHE_invalidate(BROKER_current()->host);
+         usingCachedIP = false;
+      }
+   }
    CLOUD_reset();
 
    waitingForMQTT = false;
@@ -156,6 +184,7 @@ void CLOUD_subscribe(void)
 {
 	mqttSubscribePacket cloudSubscribePacket;
 	uint8_t topicCount = 0;
+	textWriter_t topic;
 
 	// Variable header
 	cloudSubscribePacket.packetIdentifierLSB = 1;
@@ -164,7 +193,10 @@ void CLOUD_subscribe(void)
 	// Payload
 	for(topicCount = 0; topicCount < NUM_TOPICS_SUBSCRIBE; topicCount++)
 	{
-		sprintf(mqttSubscribeTopic, "/devices/%s/config", deviceId);
+		TEXT_init(&topic, mqttSubscribeTopic, TOPIC_SIZE);
+		TEXT_putString(&topic, "/devices/");
+		TEXT_putString(&topic, deviceId);
+		TEXT_putString(&topic, "/config");
 		cloudSubscribePacket.subscribePayload[topicCount].topic = (uint8_t *)mqttSubscribeTopic;
 		cloudSubscribePacket.subscribePayload[topicCount].topicLength = strlen(mqttSubscribeTopic);
 		cloudSubscribePacket.subscribePayload[topicCount].requestedQoS = 0;
@@ -190,18 +222,17 @@ void CLOUD_disconnect(void){
     }
 }
 
-// Todo: This declaration supports the hack below
-packetReceptionHandler_t* getSocketInfo(uint8_t sock);
 static int8_t connectMQTTSocket(void)
 {
    int8_t ret = false;
 
-   if (mqttGoogleApisComIP > 0)
+   if ((mqttGoogleApisComIP > 0) && shared_networking_params.haveIPAddress)
    {
       struct bsd_sockaddr_in addr;
+      const brokerEndpoint_t *endpoint = BROKER_current();
 
       addr.sin_family = PF_INET;
-      addr.sin_port = BSD_htons(443);
+      addr.sin_port = BSD_htons(endpoint->port);
       addr.sin_addr.s_addr = mqttGoogleApisComIP;
 
       mqttContext  *context = MQTT_GetClientConnectionInfo();
@@ -210,14 +241,18 @@ static int8_t connectMQTTSocket(void)
       // Todo: Check - Are we supposed to call close on the socket here to ensure we do not leak ?
       if (socketState == NOT_A_SOCKET)
       {
-         *context->tcpClientSocket = BSD_socket(PF_INET, BSD_SOCK_STREAM, 1);
+         *context->tcpClientSocket = BSD_socket(PF_INET, BSD_SOCK_STREAM, endpoint->tls ? 1 : 0);
 
          if (*context->tcpClientSocket >=0)
          {
-            packetReceptionHandler_t*  sockInfo = getSocketInfo(*context->tcpClientSocket);
-            if (sockInfo != NULL)
+            // The WINC delivers straight to where MQTT parses
+            BSD_setRecvRing(*context->tcpClientSocket, context->mqttDataExchangeBuffers.rxbuff.start,
+                            context->mqttDataExchangeBuffers.rxbuff.bufferLength);
+
+            int sessionCaching = 1;
+            if (endpoint->tls && BSD_setsockopt(*context->tcpClientSocket, BSD_SOL_SSL_SOCKET, BSD_SO_SSL_ENABLE_SESSION_CACHING, &sessionCaching, sizeof(sessionCaching)) != BSD_SUCCESS)
             {
-               sockInfo->socketState = SOCKET_CLOSED;
+               debug_printError("CLOUD: TLS session caching not enabled (%d)", BSD_GetErrNo());
             }
          }
       }
@@ -232,6 +267,13 @@ static int8_t connectMQTTSocket(void)
             shared_networking_params.haveERROR = 1;
             BSD_close(*context->tcpClientSocket);
          }
+         else
+         {
+            handshakeStart = timeout_getTime();
+            handshakeResumed = tlsSessionCached;
+            handshakePending = true;
+            connectAttempted = true;
+         }
       }
    }
    return ret;
@@ -315,12 +357,15 @@ uint32_t CLOUD_task(void *param)
             }
 			else
 			{
+               // The handler also runs the protocol timeouts: once even without data
+               MQTT_ReceivePacket(mqttConnnectionInfo);
                MQTT_ReceptionHandler(mqttConnnectionInfo);
+               while (MQTT_ReceivePacket(mqttConnnectionInfo))
+               {
+                  MQTT_ReceptionHandler(mqttConnnectionInfo);
+               }
                MQTT_TransmissionHandler(mqttConnnectionInfo);
 
-               // Todo: We already processed the data in place using PEEK, this just flushes the buffer
-               BSD_recv(*MQTT_GetClientConnectionInfo()->tcpClientSocket, MQTT_GetClientConnectionInfo()->mqttDataExchangeBuffers.rxbuff.start, MQTT_GetClientConnectionInfo()->mqttDataExchangeBuffers.rxbuff.bufferLength, 0);
-
                if (MQTT_GetConnectionState() == CONNECTED)
                {
                   shared_networking_params.haveERROR = 0;
@@ -340,6 +385,7 @@ uint32_t CLOUD_task(void *param)
 					  debug_printError("MQTT: Connection aged, Uptime %lus SocketState (%d) MQTT (%d)", thisAge , socketState, MQTT_GetConnectionState());
                      MQTT_Disconnect(mqttConnnectionInfo);
                      BSD_close(*mqttConnnectionInfo->tcpClientSocket);
+                     selectEndpoint();
                   }
                }
             }
@@ -353,6 +399,36 @@ uint32_t CLOUD_task(void *param)
 	return CLOUD_TASK_INTERVAL;
 }
 
+void CLOUD_sleep(void)
+{
+   mqttContext *context = MQTT_GetClientConnectionInfo();
+
+   timeout_delete(&CLOUD_taskTimer);
+   timeout_delete(&mqttTimeoutTaskTimer);
+   timeout_delete(&cloudResetTaskTimer);
+   MQTT_Disconnect(context);
+   MQTT_initialiseState();
+   if (BSD_GetSocketState(*context->tcpClientSocket) != NOT_A_SOCKET)
+   {
+      BSD_close(*context->tcpClientSocket);
+   }
+   wifi_disconnectFromAp();
+   cloudInitialized = false;
+   isResetting = false;
+   cloudResetTimerFlag = false;
+   waitingForMQTT = false;
+   debug_printInfo("CLOUD: sleep");
+}
+
+void CLOUD_wake(void)
+{
+   debug_printInfo("CLOUD: wake");
+   wifi_wake();
+   // Same path as a reset, without the reset delay
+   cloudInitialized = reInit();
+   timeout_create(&CLOUD_taskTimer, CLOUD_TASK_INTERVAL);
+}
+
 bool CLOUD_isConnected(void)
 {
    if (MQTT_GetConnectionState() == CONNECTED)
@@ -363,28 +439,140 @@ bool CLOUD_isConnected(void)
    }
 }
 
-void CLOUD_publishData(uint8_t* data, unsigned int len)
+bool CLOUD_isPublishPending(void)
+{
+   return MQTT_isPublishPending();
+}
+
+bool CLOUD_publishData(const char *topicSuffix, uint8_t* data, unsigned int len)
+{
+   static char publishTopic[MQTT_TOPIC_LENGTH + CLOUD_MAX_TOPIC_SUFFIX_LENGTH];
+   textWriter_t topic;
+
+   if (MQTT_isPublishPending())
+   {
+      return false;
+   }
+   TEXT_init(&topic, publishTopic, sizeof(publishTopic));
+   TEXT_putString(&topic, mqttTopic);
+   TEXT_putString(&topic, topicSuffix);
+   if (TEXT_length(&topic) == 0)
+   {
+      debug_printError("CLOUD: topic suffix too long");
+      return false;
+   }
+   return MQTT_CLIENT_publish(publishTopic, data, len);
+}
+
+const tlsHandshakeStats_t *CLOUD_getHandshakeStats(bool resumed)
+{
+   return &handshakeStats[resumed ? 1 : 0];
+}
+
+static void recordHandshake(bool success)
 {
-   MQTT_CLIENT_publish(data, len);
+   handshakePending = false;
+   if (!success)
+   {
+      // Do not count failures, and do not offer a session the broker may have refused
+      tlsSessionCached = false;
+      return;
+   }
+
+   uint16_t elapsed = timeout_toMs(timeout_getTime() - handshakeStart);
+   tlsHandshakeStats_t *stats = &handshakeStats[handshakeResumed ? 1 : 0];
+
+   stats->count++;
+   stats->lastMs = elapsed;
+   stats->totalMs += elapsed;
+   if (elapsed > stats->maxMs)
+   {
+      stats->maxMs = elapsed;
+   }
+   tlsSessionCached = true;
+   BROKER_reportHandshake(elapsed, handshakeResumed);
+   debug_printInfo("CLOUD: TLS %s handshake %ums", handshakeResumed ? "resumed" : "full", elapsed);
+}
+
+// Time the TLS handshake of the MQTT socket, then hand over to the BSD layer
+static void socketHandler(SOCKET sock, uint8_t msgType, void *pMsg)
+{
+   if ((msgType == SOCKET_MSG_CONNECT) && handshakePending && pMsg
+         && (sock == *MQTT_GetClientConnectionInfo()->tcpClientSocket))
+   {
+      recordHandshake(((tstrSocketConnectMsg *)pMsg)->s8Error >= 0);
+   }
+   BSD_SocketHandler(sock, msgType, pMsg);
 }
 
 static void dnsHandler(uint8_t* domainName, uint32_t serverIP)
 {
     if(serverIP != 0)
     {
+        DNS_CACHE_store((char*)domainName, serverIP);
+        if (strcmp((char*)domainName, BROKER_current()->host) != 0)
+        {
+            return;     // answer for an endpoint we moved away from
+        }
         mqttGoogleApisComIP = serverIP;
+        usingCachedIP = false;
         debug_printInfo("CLOUD: mqttGoogleApisComIP = (%lu.%lu.%lu.%lu)",(0x0FF & (serverIP)),(0x0FF & (serverIP>>8)),(0x0FF & (serverIP>>16)),(0x0FF & (serverIP>>24)));
     }
 }
 
+// Choose the broker for the next connection, fetching its address if it is on another host
+static void selectEndpoint(void)
+{
+   const brokerEndpoint_t *previous = BROKER_current();
+   const brokerEndpoint_t *endpoint = BROKER_select();
+   const char *host = endpoint->host;
+
+   if (endpoint != previous)
+   {
+      // The cached session belongs to the previous endpoint: the next handshake is a full one
+      tlsSessionCached = false;
+   }
+   if (strcmp(host, previous->host) != 0)
+   {
+      // Use the cached address (if any) meanwhile, the lookup answer lands in dnsHandler
+      mqttGoogleApisComIP = DNS_CACHE_get(host);
+      usingCachedIP = (mqttGoogleApisComIP != 0);
+      gethostbyname((uint8_t*)host);
+   }
+}
+
 static void updateJWT(uint32_t epoch)
 {
    char ateccsn[20];
+   textWriter_t text;
+
    CRYPTO_CLIENT_printSerialNumber(ateccsn);
-   sprintf(deviceId, "d%s", ateccsn);
+   TEXT_init(&text, deviceId, CLOUD_MAX_DEVICEID_LENGTH);
+   TEXT_putChar(&text, 'd');
+   TEXT_putString(&text, ateccsn);
+
+   TEXT_init(&text, cid, MQTT_CID_LENGTH);
+   TEXT_putString(&text, "projects/");
+   TEXT_putString(&text, projectId);
+   TEXT_putString(&text, "/locations/");
+   TEXT_putString(&text, projectRegion);
+   TEXT_putString(&text, "/registries/");
+   TEXT_putString(&text, registryId);
+   TEXT_putString(&text, "/devices/");
+   TEXT_putString(&text, deviceId);
+   if (TEXT_length(&text) == 0)
+   {
+      debug_printError("MQTT: client id too long");
+   }
 
-   sprintf(cid, "projects/%s/locations/%s/registries/%s/devices/%s", projectId, projectRegion, registryId, deviceId);
-   sprintf(mqttTopic, "/devices/%s/events", deviceId);
+   TEXT_init(&text, mqttTopic, MQTT_TOPIC_LENGTH);
+   TEXT_putString(&text, "/devices/");
+   TEXT_putString(&text, deviceId);
+   TEXT_putString(&text, "/events");
+   if (TEXT_length(&text) == 0)
+   {
+      debug_printError("MQTT: topic too long");
+   }
 
 //   debug_printInfo("MQTT: cid=%s", cid);
 //   debug_printInfo("MQTT: mqttTopic=%s", mqttTopic);
@@ -398,23 +586,31 @@ static uint8_t reInit(void)
 {
     debug_printInfo("CLOUD: reinit");
 
-    mqttGoogleApisComIP = 0;
+    // Connect to the last known broker address as soon as DHCP completes,
+    // the lookup issued at DHCP time will refresh it in the background
+    BROKER_select();
+    mqttGoogleApisComIP = DNS_CACHE_get(BROKER_current()->host);
+    usingCachedIP = (mqttGoogleApisComIP != 0);
     shared_networking_params.haveAPConnection = 0;
+    shared_networking_params.haveIPAddress = 0;
     waitingForMQTT = false;
+    // Resetting the WINC drops its TLS session cache
+    tlsSessionCached = false;
+    handshakePending = false;
+    connectAttempted = false;
     isResetting = false;
 	uint8_t wifi_creds;
 
     //Re-init the WiFi
     wifi_reinit();
 
-    registerSocketCallback(BSD_SocketHandler, dnsHandler);
+    registerSocketCallback(socketHandler, dnsHandler);
 
     MQTT_ClientInitialise();
-    memset(&cloud_packetReceiveCallBackTable, 0, sizeof(cloud_packetReceiveCallBackTable));
-    BSD_SetRecvHandlerTable(cloud_packetReceiveCallBackTable);
-
-    cloud_packetReceiveCallBackTable[0].socket = MQTT_GetClientConnectionInfo()->tcpClientSocket;
-    cloud_packetReceiveCallBackTable[0].recvCallBack = MQTT_CLIENT_receive;
+    BSD_reset();
+#if CFG_MQTT_SN
+    MQTT_SN_reset();
+#endif
 
     //When the input comes through cli/.cfg
     if((*ssid!='\0') && (authType != 0))
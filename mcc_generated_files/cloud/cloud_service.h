@@ -9,17 +9,38 @@
 #define CLOUD_SERVICE_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "../utils/compiler.h"
 
-#define CLOUD_PACKET_RECV_TABLE_SIZE	2
 #define CLOUD_MAX_DEVICEID_LENGTH 30
 #define PASSWORD_SPACE 456
+#define CLOUD_MAX_TOPIC_SUFFIX_LENGTH 16
+
+// TLS handshake timings of the MQTT socket (connect request to SOCKET_MSG_CONNECT)
+typedef struct
+{
+   uint16_t count;
+   uint16_t lastMs;
+   uint16_t maxMs;
+   uint32_t totalMs;
+} tlsHandshakeStats_t;
 
 void CLOUD_reset(void);
 void CLOUD_init(char* deviceId);
 void CLOUD_subscribe(void);
 void CLOUD_disconnect(void);
 bool CLOUD_isConnected(void);
-void CLOUD_publishData(uint8_t *data, unsigned int len);
+// Publish to the device events topic followed by topicSuffix ("" for none).
+// Returns false if the previous publish is still queued: data is referenced
+// until it is sent, see CLOUD_isPublishPending()
+bool CLOUD_publishData(const char *topicSuffix, uint8_t *data, unsigned int len);
+bool CLOUD_isPublishPending(void);
+// Close the broker connection and leave the AP, then (a few hundred ms later,
+// once the WINC has sent them) power the WINC down with wifi_sleep()
+void CLOUD_sleep(void);
+// Power the WINC up and reconnect, to the cached broker address if any
+void CLOUD_wake(void);
+// Statistics of the full (resumed == false) or resumed TLS handshakes
+const tlsHandshakeStats_t *CLOUD_getHandshakeStats(bool resumed);
 
 #endif /* CLOUD_SERVICE_H_ */
\ No newline at end of file
@@ -31,6 +31,7 @@
 #include "crypto_client.h"
 #include "../cloud_service.h"
 #include "../../debug_print.h"
+#include "../../utils/text_writer.h"
 
 #ifndef ATCA_NO_HEAP
 #error : This project uses CryptoAuthLibrary V2. Please add "ATCA_NO_HEAP" to toolchain symbols.
@@ -156,7 +157,7 @@ uint8_t CRYPTO_CLIENT_printPublicKey(char *s)
 uint8_t CRYPTO_CLIENT_printSerialNumber(char *s)
 {
     ATCA_STATUS status = ATCA_SUCCESS;
-	uint8_t i = 0;
+    textWriter_t text;
 
     int retVal = atcab_init(&cfg_ateccx08a_i2c_custom);
 
@@ -169,11 +170,8 @@ uint8_t CRYPTO_CLIENT_printSerialNumber(char *s)
 
     if (status == ATCA_SUCCESS)
     {
-        for (i = 0; i < ATCA_SERIAL_NUM_SIZE; i++)
-        {
-            sprintf(s, "%02X", g_serial_number[i]);
-            s += 2;
-        }
+        TEXT_init(&text, s, ATCA_SERIAL_NUM_SIZE * 2 + 1);
+        TEXT_putHex(&text, g_serial_number, ATCA_SERIAL_NUM_SIZE);
     }
     else{
         return ERROR;
@@ -0,0 +1,132 @@
+/*
+    \file   dns_cache.c
+
+    \brief  Broker address cache source file.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <avr/eeprom.h>
+#include "dns_cache.h"
+#include "../config/mqtt_config.h"
+#include "../debug_print.h"
+
+#define DNS_CACHE_MAGIC     0xD5
+
+typedef struct
+{
+   uint8_t  magic;
+   uint16_t hostHash;
+   uint32_t address;
+   time_t   resolvedAt;   // 0 when the clock was not set at resolution time
+} dnsCacheEntry_t;
+
+static dnsCacheEntry_t EEMEM dnsCacheTable[CFG_DNS_CACHE_ENTRIES];
+
+// djb2, folded to 16 bits: we only need to tell a handful of host names apart
+static uint16_t hashHost(const char *host)
+{
+   uint16_t hash = 5381;
+   while (*host)
+   {
+      hash = (hash << 5) + hash + (uint8_t)*host++;
+   }
+   return hash;
+}
+
+// Returns the index of the entry for hash, or of the slot to (re)use for it
+static uint8_t findEntry(uint16_t hash, dnsCacheEntry_t *entry, bool *found)
+{
+   uint8_t i;
+   uint8_t victim = 0;
+   bool haveFree = false;
+   time_t oldest = 0;
+
+   for (i = 0; i < CFG_DNS_CACHE_ENTRIES; i++)
+   {
+      eeprom_read_block(entry, &dnsCacheTable[i], sizeof(dnsCacheEntry_t));
+      if (entry->magic != DNS_CACHE_MAGIC)
+      {
+         if (!haveFree)
+         {
+            haveFree = true;
+            victim = i;
+         }
+         continue;
+      }
+      if (entry->hostHash == hash)
+      {
+         *found = true;
+         return i;
+      }
+      // No free slot (yet): evict the oldest resolution
+      if (!haveFree && ((i == 0) || (entry->resolvedAt < oldest)))
+      {
+         oldest = entry->resolvedAt;
+         victim = i;
+      }
+   }
+   *found = false;
+   return victim;
+}
+
+static bool isExpired(const dnsCacheEntry_t *entry, time_t now)
+{
+   // Without a valid clock (typically at boot) we cannot age the entry: use it,
+   // the background lookup will correct it if the broker has moved
+   if ((now <= 0) || (entry->resolvedAt == 0))
+   {
+      return false;
+   }
+   return ((uint32_t)(now - entry->resolvedAt) > CFG_MQTT_DNS_CACHE_TTL);
+}
+
+uint32_t DNS_CACHE_get(const char *host)
+{
+   dnsCacheEntry_t entry;
+   bool found;
+
+   findEntry(hashHost(host), &entry, &found);
+   if (!found || isExpired(&entry, time(NULL)))
+   {
+      return 0;
+   }
+   debug_printInfo("DNS: cached %s", host);
+   return entry.address;
+}
+
+void DNS_CACHE_store(const char *host, uint32_t address)
+{
+   dnsCacheEntry_t entry;
+   bool found;
+   uint16_t hash = hashHost(host);
+   time_t now = time(NULL);
+   uint8_t i = findEntry(hash, &entry, &found);
+
+   // Limit EEPROM wear: same address and not yet half way through its TTL
+   if (found && (entry.address == address) && (entry.resolvedAt != 0)
+         && !isExpired(&entry, now + CFG_MQTT_DNS_CACHE_TTL / 2))
+   {
+      return;
+   }
+
+   entry.magic = DNS_CACHE_MAGIC;
+   entry.hostHash = hash;
+   entry.address = address;
+   entry.resolvedAt = (now > 0) ? now : 0;
+   eeprom_update_block(&entry, &dnsCacheTable[i], sizeof(dnsCacheEntry_t));
+}
+
+void DNS_CACHE_invalidate(const char *host)
+{
+   dnsCacheEntry_t entry;
+   bool found;
+   uint8_t i = findEntry(hashHost(host), &entry, &found);
+
+   if (found)
+   {
+      eeprom_update_byte(&dnsCacheTable[i].magic, 0xFF);
+      debug_printInfo("DNS: dropped %s", host);
+   }
+}
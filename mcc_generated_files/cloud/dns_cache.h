@@ -0,0 +1,24 @@
+/*
+    \file   dns_cache.h
+
+    \brief  Broker address cache header file.
+
+    The last address resolved for a host name is kept in EEPROM so that the
+    MQTT socket can be opened right after DHCP, without waiting for a DNS
+    round trip. A fresh lookup is always issued in the background.
+*/
+
+#ifndef DNS_CACHE_H_
+#define DNS_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Returns the cached address for host, or 0 if none (or expired)
+uint32_t DNS_CACHE_get(const char *host);
+// Record a freshly resolved address for host
+void DNS_CACHE_store(const char *host, uint32_t address);
+// Drop the entry for host, e.g. after a connection to it failed
+void DNS_CACHE_invalidate(const char *host);
+
+#endif /* DNS_CACHE_H_ */
@@ -34,8 +34,6 @@
 #include "../../debug_print.h"
 
 
-#define MQTT_CID_LENGTH 100
-#define MQTT_TOPIC_LENGTH 38
 
 char mqttPassword[456];
 char cid[MQTT_CID_LENGTH];
@@ -43,7 +41,7 @@ char mqttTopic[MQTT_TOPIC_LENGTH];
 char mqttHostName[] = CFG_MQTT_HOST;
 
 
-void MQTT_CLIENT_publish(uint8_t *data, uint16_t len)
+bool MQTT_CLIENT_publish(char *topic, uint8_t *data, uint16_t len)
 {
 	 mqttPublishPacket cloudPublishPacket;
     
@@ -53,7 +51,7 @@ void MQTT_CLIENT_publish(uint8_t *data, uint16_t len)
     cloudPublishPacket.publishHeaderFlags.retain = 0;
     
     // Variable header
-    cloudPublishPacket.topic = (uint8_t*)mqttTopic;
+    cloudPublishPacket.topic = (uint8_t*)topic;
     
     // Payload
     cloudPublishPacket.payload = data;
@@ -63,12 +61,9 @@ void MQTT_CLIENT_publish(uint8_t *data, uint16_t len)
     if(MQTT_CreatePublishPacket(&cloudPublishPacket) != true)
     {
         debug_printError("MQTT: Connection lost PUBLISH failed");
+        return false;
     }
-}
-
-void MQTT_CLIENT_receive(uint8_t *data, uint8_t len)
-{
-    MQTT_GetReceivedData(data, len);
+    return true;
 }
 
 void MQTT_CLIENT_connect(void)
@@ -33,13 +33,16 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define MQTT_CID_LENGTH 100
+#define MQTT_TOPIC_LENGTH 38
+
 extern char mqttPassword[];
 extern char cid[];
 extern char mqttTopic[];
 extern char mqttHostName[];
 
-void MQTT_CLIENT_publish(uint8_t *data, uint16_t len);
-void MQTT_CLIENT_receive(uint8_t *data, uint8_t len);
+// topic and data are referenced, not copied, until the packet is sent
+bool MQTT_CLIENT_publish(char *topic, uint8_t *data, uint16_t len);
 void MQTT_CLIENT_connect(void);
 
 #endif /* MQTT_PACKET_POPULATE_H */
\ No newline at end of file
@@ -0,0 +1,112 @@
+/*
+    \file   wifi_cache.c
+
+    \brief  Access point cache source file.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <avr/eeprom.h>
+#include "wifi_cache.h"
+#include "../time_service.h"
+#include "../debug_print.h"
+
+#define WIFI_CACHE_MAGIC    0xA5
+#define LEASE_INFINITE      0xFFFFFFFFUL
+
+typedef struct
+{
+   uint8_t  magic;
+   uint16_t ssidHash;
+   uint8_t  channel;        // 0 when not known
+   tstrM2MIPConfig lease;   // u32StaticIP 0 when none
+   time_t   leasedAt;       // 0 when the clock was not set at DHCP time
+} wifiCacheEntry_t;         // 28 bytes
+
+static wifiCacheEntry_t EEMEM wifiCacheEntry;
+
+// djb2, folded to 16 bits, as for the broker address cache
+static uint16_t hashSsid(const char *ssid)
+{
+   uint16_t hash = 5381;
+   while (*ssid)
+   {
+      hash = (hash << 5) + hash + (uint8_t)*ssid++;
+   }
+   return hash;
+}
+
+static bool readEntry(const char *ssid, wifiCacheEntry_t *entry)
+{
+   eeprom_read_block(entry, &wifiCacheEntry, sizeof(wifiCacheEntry_t));
+   return (entry->magic == WIFI_CACHE_MAGIC) && (!ssid || (entry->ssidHash == hashSsid(ssid)));
+}
+
+bool WIFI_CACHE_getChannel(const char *ssid, uint8_t *channel)
+{
+   wifiCacheEntry_t entry;
+
+   if (!readEntry(ssid, &entry) || (entry.channel == 0))
+   {
+      return false;
+   }
+   *channel = entry.channel;
+   return true;
+}
+
+bool WIFI_CACHE_getLease(const char *ssid, tstrM2MIPConfig *lease)
+{
+   wifiCacheEntry_t entry;
+   uint32_t age;
+
+   // Unlike a broker address, an address not aged by the clock is not used:
+   // it may have been given to another device
+   if (!readEntry(ssid, &entry) || (entry.lease.u32StaticIP == 0) || (entry.leasedAt == 0) || !TIME_isSet())
+   {
+      return false;
+   }
+   age = (uint32_t)(time(NULL) - entry.leasedAt);
+   if ((entry.lease.u32DhcpLeaseTime != LEASE_INFINITE) && (age >= entry.lease.u32DhcpLeaseTime / 2))
+   {
+      return false;
+   }
+   *lease = entry.lease;
+   return true;
+}
+
+void WIFI_CACHE_store(const char *ssid, uint8_t channel, const tstrM2MIPConfig *lease)
+{
+   wifiCacheEntry_t entry;
+   bool sameNetwork = readEntry(ssid, &entry);
+
+   if (!sameNetwork)
+   {
+      memset(&entry, 0, sizeof(entry));
+      entry.magic = WIFI_CACHE_MAGIC;
+      entry.ssidHash = hashSsid(ssid);
+   }
+   // A directed association that fails drops the channel, should it be stale
+   if (channel)
+   {
+      entry.channel = channel;
+   }
+   if (lease)
+   {
+      entry.lease = *lease;
+      entry.leasedAt = TIME_isSet() ? time(NULL) : 0;
+   }
+   // eeprom_update_block() only rewrites the bytes that change
+   eeprom_update_block(&entry, &wifiCacheEntry, sizeof(wifiCacheEntry_t));
+}
+
+void WIFI_CACHE_invalidateAp(void)
+{
+   eeprom_update_byte(&wifiCacheEntry.channel, 0);
+   debug_printInfo("WIFI: cached channel dropped");
+}
+
+void WIFI_CACHE_invalidateLease(void)
+{
+   eeprom_update_dword((uint32_t *)&wifiCacheEntry.lease.u32StaticIP, 0);
+}
@@ -0,0 +1,41 @@
+/*
+    \file   wifi_cache.h
+
+    \brief  Access point cache header file.
+
+    The channel of the last access point joined is kept in EEPROM, with the
+    DHCP lease got there, for a fast reconnect: an association on that single
+    channel instead of a scan of all channels, and no DHCP exchange while the
+    lease is in its first half. Only a hash of the SSID is kept, to tell
+    whether the entry applies to a network.
+
+    The association can only be directed while the host has the passphrase,
+    which is cleared once connected: for credentials just entered (CLI,
+    provisioning, the compile time network). Otherwise the WINC connects to
+    the network saved in its flash, scanning all channels: the driver has no
+    directed form of the default connect. Only the cached lease applies then.
+    The driver cannot direct an association to a BSSID either, so none is
+    kept.
+*/
+
+#ifndef WIFI_CACHE_H_
+#define WIFI_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../winc/driver/include/m2m_types.h"
+
+// Channel cached for ssid (any network if NULL): false if none
+bool WIFI_CACHE_getChannel(const char *ssid, uint8_t *channel);
+// The lease cached for ssid (any network if NULL), if still in its first half
+// by a set clock: false otherwise
+bool WIFI_CACHE_getLease(const char *ssid, tstrM2MIPConfig *lease);
+// Record the network joined, its channel (0 if not known: the cached one is
+// kept if the network is the same) and the lease got there (NULL: likewise)
+void WIFI_CACHE_store(const char *ssid, uint8_t channel, const tstrM2MIPConfig *lease);
+// Forget the channel, e.g. after an association on it failed
+void WIFI_CACHE_invalidateAp(void);
+// Drop the lease only, e.g. after an address conflict
+void WIFI_CACHE_invalidateLease(void);
+
+#endif /* WIFI_CACHE_H_ */
@@ -36,10 +36,22 @@ SOFTWARE.
 #include "../config/conf_winc.h"
 #include "../config/mqtt_config.h"
 #include "../winc/socket/include/socket.h"
+#include "broker_endpoints.h"
+#include "wifi_cache.h"
+#include "../time_service.h"
+#include "../include/pin_manager.h"
+#include "../winc/bsp/include/nm_bsp_mega.h"
+#include "../power_save.h"
 
 #define CLOUD_WIFI_TASK_INTERVAL        50L
-#define CLOUD_NTP_TASK_INTERVAL         32000L  // resync every 32 seconds
+#if CFG_WIFI_IRQ_EVENTS
+#define WIFI_POLL_INTERVAL              CFG_WIFI_POLL_INTERVAL
+#else
+#define WIFI_POLL_INTERVAL              CLOUD_WIFI_TASK_INTERVAL
+#endif
+#define CLOUD_NTP_TASK_INTERVAL         (CFG_NTP_MIN_INTERVAL * 1000L)  // check whether a resync is due
 #define SOFT_AP_CONNECT_RETRY_INTERVAL  1000L
+#define LEASE_CHECK_INTERVAL            30000L
 
 // wifi credential buffers
 char ssid[M2M_MAX_SSID_LEN];
@@ -60,6 +72,29 @@ timerStruct_t checkBackTimer  = {checkBackTask};
 
 static bool responseFromProvisionConnect = false;
 
+// The HIF is up: WINC events may be handled
+static bool handlingEvents = false;
+static wifiEventStats_t eventStats;
+
+uint32_t leaseTask(void *payload);
+timerStruct_t leaseTimer = {leaseTask};
+
+// Fast reconnect, see wifi_cache.h
+static wifiConnectStats_t connectStats;
+static uint8_t connectChannel = M2M_WIFI_CH_ALL;   // asked for
+static bool directedConnect = false;    // on the cached channel: scan them all should it fail
+static bool associated = false;
+static bool presetAddress = false;      // static or cached lease: no DHCP exchange
+static bool cachedLease = false;
+static uint16_t savedCredentials = 0;   // hash of the credentials the WINC saved in its flash
+static uint8_t scanCount;
+static uint8_t scanIndex;
+static int8_t scanRssi;
+static uint8_t scanChannel;
+static uint32_t connectStartMs;
+static uint32_t associatedMs;
+static tstrM2MIPConfig ipConfig;
+
 void (*callback_funcPtr)(uint8_t);
 
 void enable_provision_ap(void);
@@ -81,6 +116,7 @@ void wifi_reinit()
      memset((uint8_t *)&param, 0, sizeof(tstrWifiInitParam));
 
      param.pfAppWifiCb = wifiCallback;
+     POWER_SAVE_stop(true);
      socketDeinit();
      hif_deinit(NULL);
      nm_bsp_deinit();
@@ -115,19 +151,115 @@ void wifi_init(void (*funcPtr)(uint8_t), uint8_t mode) {
    }
 
 
-   timeout_create(&wifiHandlerTimer, CLOUD_WIFI_TASK_INTERVAL);
+   handlingEvents = true;
+   timeout_create(&wifiHandlerTimer, WIFI_POLL_INTERVAL);
+}
+
+static uint16_t hashString(uint16_t hash, const char *s)
+{
+   while (*s)
+   {
+      hash = (hash << 5) + hash + (uint8_t)*s++;
+   }
+   return hash;
+}
+
+static uint16_t credentialsHash(void)
+{
+   return hashString(hashString(5381 + authType, ssid), pass);
+}
+
+// No DHCP exchange with a static address (CFG_WIFI_STATIC_IP), or with a lease
+// cached for network (NULL: the one the WINC picks) in its first half
+static void setAddress(const char *network)
+{
+   cachedLease = false;
+   presetAddress = (sizeof(CFG_WIFI_STATIC_IP) > 1);
+   if (presetAddress)
+   {
+      ipConfig.u32StaticIP = nmi_inet_addr((char *)CFG_WIFI_STATIC_IP);
+      ipConfig.u32Gateway = nmi_inet_addr((char *)CFG_WIFI_STATIC_GATEWAY);
+      ipConfig.u32DNS = nmi_inet_addr((char *)CFG_WIFI_STATIC_DNS);
+      ipConfig.u32SubnetMask = nmi_inet_addr((char *)CFG_WIFI_STATIC_NETMASK);
+      ipConfig.u32DhcpLeaseTime = 0;
+   }
+#if CFG_WIFI_FAST_RECONNECT
+   else
+   {
+      presetAddress = cachedLease = WIFI_CACHE_getLease(network, &ipConfig);
+   }
+#endif
+   // The address itself is set once associated
+   m2m_wifi_enable_dhcp(presetAddress ? 0 : 1);
+}
+
+static int8_t connectOn(uint8_t channel)
+{
+   connectChannel = channel;
+   associated = false;
+   // Credentials the WINC saved already are not written to its flash again
+   return m2m_wifi_connect_sc(ssid, strlen(ssid), authType, pass, channel, savedCredentials == credentialsHash());
+}
+
+static int8_t scanAll(void)
+{
+   connectStats.scans++;
+   scanRssi = -128;
+   scanChannel = M2M_WIFI_CH_ALL;
+   return m2m_wifi_request_scan(M2M_WIFI_CH_ALL);
+}
+
+static void nextScanResult(void)
+{
+   if (scanIndex < scanCount)
+   {
+      m2m_wifi_req_scan_result(scanIndex++);
+   }
+   // The strongest access point of the network, on any channel if none was seen (hidden SSID)
+   else if (connectOn(scanChannel) != M2M_SUCCESS)
+   {
+      shared_networking_params.haveERROR = 1;
+   }
+}
+
+static int8_t connectWithCredentials(void)
+{
+   directedConnect = false;
+   setAddress(ssid);
+#if CFG_WIFI_FAST_RECONNECT
+   // Not while provisioning: the WINC is leaving its access point mode
+   if (!responseFromProvisionConnect)
+   {
+      uint8_t channel;
+
+      if (WIFI_CACHE_getChannel(ssid, &channel))
+      {
+         directedConnect = true;
+         connectStats.directed++;
+         return connectOn(channel);
+      }
+      // Found on one channel, its association is directed next time
+      return scanAll();
+   }
+#endif
+   return connectOn(M2M_WIFI_CH_ALL);
 }
 
 bool wifi_connectToAp(uint8_t passed_wifi_creds)
 {
 	int8_t e = 0;
 
+	connectStartMs = TIME_getMonotonicMs();
 	if(passed_wifi_creds == NEW_CREDENTIALS)
 	{
-		e = m2m_wifi_connect((char *)ssid, strlen(ssid), authType, (char *)pass, M2M_WIFI_CH_ALL);
+		e = connectWithCredentials();
 	}
 	else
 	{
+		// Only the WINC knows the credentials: it scans for its saved network
+		setAddress(NULL);
+		connectChannel = M2M_WIFI_CH_ALL;
+		associated = false;
 		e = m2m_wifi_default_connect();
 	}
 
@@ -168,24 +300,139 @@ bool wifi_disconnectFromAp(void)
 	return true;
 }
 
-// Update the system time every CLOUD_NTP_TASK_INTERVAL milliseconds
+void wifi_sleep(void)
+{
+	handlingEvents = false;
+	timeout_delete(&wifiHandlerTimer);
+	timeout_delete(&ntpTimeFetchTimer);
+	timeout_delete(&checkBackTimer);
+	timeout_delete(&leaseTimer);
+	POWER_SAVE_stop(true);
+	socketDeinit();
+	hif_deinit(NULL);
+	nm_bsp_deinit();
+	CONF_WIFI_M2M_CHIP_ENABLE_PIN_SetLow();
+	CONF_WIFI_M2M_RESET_PIN_SetLow();
+	nm_bsp_chip_awake(0);
+
+	shared_networking_params.haveAPConnection = 0;
+	shared_networking_params.haveIPAddress = 0;
+	shared_networking_params.amDisconnecting = 0;
+	// A planned power down is not an error, keep the red LED off
+	shared_networking_params.haveERROR = 0;
+}
+
+void wifi_wake(void)
+{
+	timeout_create(&ntpTimeFetchTimer, CLOUD_NTP_TASK_INTERVAL);
+	handlingEvents = true;
+	timeout_create(&wifiHandlerTimer, WIFI_POLL_INTERVAL);
+}
+
+// Ask the WINC for the time when the time service needs a new sample
 uint32_t ntpTimeFetchTask(void *payload)
 {
-    m2m_wifi_get_system_time();
+    if (TIME_isSyncDue())
+    {
+        m2m_wifi_get_system_time();
+    }
     return CLOUD_NTP_TASK_INTERVAL;
 }
 
 
-uint32_t wifiHandlerTask(void * param)
+// Interrupt to handler: to the microsecond within a scheduler tick (the ticks
+// wrap every ~13ms), to the scheduler tick beyond
+static void recordLatency(uint16_t ticks, uint16_t ms)
+{
+   uint16_t elapsed = timeout_getTime() - ms;
+   uint32_t us = elapsed ? timeout_toUs(elapsed) : (uint16_t)(TIME_getTicks() - ticks) / TIME_TICKS_PER_US;
+
+   eventStats.latency.count++;
+   eventStats.latency.last = us;
+   eventStats.latency.total += us;
+   if (us > eventStats.latency.max)
+   {
+      eventStats.latency.max = us;
+   }
+}
+
+static void handleEvents(bool poll)
 {
+   uint16_t ticks;
+   uint16_t ms;
+   uint8_t event;
+
+   if (!handlingEvents)
+   {
+      return;
+   }
+   event = nm_bsp_take_event(&ticks, &ms);
+   if (poll)
+   {
+      eventStats.polls++;
+      if (event == NM_BSP_EVENT_NONE)
+      {
+         eventStats.idlePolls++;
+      }
+   }
+   if (event == NM_BSP_EVENT_NONE)
+   {
+      return;
+   }
+   if (event == NM_BSP_EVENT_LINE)
+   {
+      eventStats.missedEdges++;
+   }
+   else
+   {
+      recordLatency(ticks, ms);
+   }
    m2m_wifi_handle_events(NULL);
-   return CLOUD_WIFI_TASK_INTERVAL;
+}
+
+void wifi_handleEvents(void)
+{
+#if CFG_WIFI_IRQ_EVENTS
+   handleEvents(false);
+#endif
+}
+
+const wifiEventStats_t *wifi_getEventStats(void)
+{
+   return &eventStats;
+}
+
+const wifiConnectStats_t *wifi_getConnectStats(void)
+{
+   return &connectStats;
+}
+
+// Connected on a cached lease: renew it through DHCP once past its first half
+uint32_t leaseTask(void *payload)
+{
+   tstrM2MIPConfig lease;
+
+   if (WIFI_CACHE_getLease(NULL, &lease))
+   {
+      return LEASE_CHECK_INTERVAL;
+   }
+   debug_printInfo("WIFI: cached lease half way, reconnecting with DHCP");
+   wifi_disconnectFromAp();
+   return 0;
+}
+
+// With CFG_WIFI_IRQ_EVENTS only a fallback, should the interrupt be lost
+uint32_t wifiHandlerTask(void * param)
+{
+   handleEvents(true);
+   return WIFI_POLL_INTERVAL;
 }
 
 uint32_t checkBackTask(void * param)
 {
 	debug_printError("wifi_cb: M2M_WIFI_RESP_CON_STATE_CHANGED: DISCONNECTED");
 	shared_networking_params.haveAPConnection = 0;
+	shared_networking_params.haveIPAddress = 0;
 	shared_networking_params.haveERROR = 1;
 	shared_networking_params.amDisconnecting = 0;
 	return 0;
@@ -198,6 +445,44 @@ void CREDENTIALS_STORAGE_clearWifiCredentials(void)
 	authType = 0;
 }
 
+// Connected with an IP address, from DHCP or preset
+static void addressReady(void)
+{
+   if (associated && !shared_networking_params.haveIPAddress)
+   {
+      uint32_t ms = TIME_getMonotonicMs() - associatedMs;
+
+      connectStats.addresses++;
+      connectStats.lastAddressMs = ms;
+      connectStats.totalAddressMs += ms;
+      debug_printInfo("WIFI: associated in %lums, IP address %lums later%s", connectStats.lastAssociationMs, ms,
+                      presetAddress ? " (no DHCP)" : "");
+   }
+#if CFG_WIFI_FAST_RECONNECT
+   // The SSID joined, to cache the channel and lease for it
+   m2m_wifi_get_connection_info();
+   if (cachedLease)
+   {
+      timeout_create(&leaseTimer, LEASE_CHECK_INTERVAL);
+   }
+#endif
+   // A cached broker address can be used from here on, while the lookup refreshes it
+   shared_networking_params.haveIPAddress = 1;
+   // Not before: power save would slow the DHCP exchange down
+   POWER_SAVE_start();
+   // Now we are really connected, we have AP and we have DHCP, start off the MQTT host lookup now, response in dnsHandler
+   if (gethostbyname((uint8_t*)BROKER_current()->host) == M2M_SUCCESS)
+   {
+      if (shared_networking_params.amDisconnecting == 1)
+      {
+         timeout_delete(&checkBackTimer);
+         shared_networking_params.amDisconnecting = 0;
+      }
+      shared_networking_params.haveERROR = 0;
+      debug_printGOOD("CLOUD: DHCP CONF");
+   }
+}
+
 static void wifiCallback(uint8_t msgType, void *pMsg)
 {
     switch (msgType) {
@@ -216,11 +501,42 @@ static void wifiCallback(uint8_t msgType, void *pMsg)
 				}
 				shared_networking_params.haveAPConnection = 1;
                 debug_printGOOD("wifi_cb: M2M_WIFI_RESP_CON_STATE_CHANGED: CONNECTED");
+				// Only a hash stays in RAM, to tell credentials the WINC saved already
+				if (*ssid)
+				{
+					savedCredentials = credentialsHash();
+				}
 				CREDENTIALS_STORAGE_clearWifiCredentials();
                 LED_stopBlinkingGreen();
+				associated = true;
+				associatedMs = TIME_getMonotonicMs();
+				connectStats.lastAssociationMs = associatedMs - connectStartMs;
                 // We need more than AP to have an APConnection, we also need a DHCP IP address!
+				if (presetAddress)
+				{
+					// Converted in place to the WINC byte order
+					tstrM2MIPConfig config = ipConfig;
+
+					m2m_wifi_set_static_ip(&config);
+					connectStats.presetAddresses++;
+					addressReady();
+				}
             } else if (pstrWifiState->u8CurrState == M2M_WIFI_DISCONNECTED)
 			{
+				POWER_SAVE_stop(false);
+				timeout_delete(&leaseTimer);
+				if (!associated && directedConnect)
+				{
+					// Not found on its cached channel: scan them all
+					directedConnect = false;
+					connectStats.fallbacks++;
+					WIFI_CACHE_invalidateAp();
+					if (scanAll() == M2M_SUCCESS)
+					{
+						break;
+					}
+				}
+				associated = false;
                 timeout_create(&checkBackTimer,CLOUD_WIFI_TASK_INTERVAL);
 				shared_networking_params.amDisconnecting = 1;
             }
@@ -234,17 +550,67 @@ static void wifiCallback(uint8_t msgType, void *pMsg)
 
         case M2M_WIFI_REQ_DHCP_CONF:
         {
-            // Now we are really connected, we have AP and we have DHCP, start off the MQTT host lookup now, response in dnsHandler
-            if (gethostbyname((uint8_t*)CFG_MQTT_HOST) == M2M_SUCCESS)
+            // A preset address is handled at association
+            if (!presetAddress)
             {
-				if (shared_networking_params.amDisconnecting == 1)
-				{
-					timeout_delete(&checkBackTimer);
-					shared_networking_params.amDisconnecting = 0;
-				}
-				shared_networking_params.haveERROR = 0;
-                debug_printGOOD("CLOUD: DHCP CONF");
+                ipConfig = *(tstrM2MIPConfig *)pMsg;
+                addressReady();
+            }
+            break;
+        }
+
+        case M2M_WIFI_RESP_CONN_INFO:
+        {
+            tstrM2MConnInfo *info = (tstrM2MConnInfo *)pMsg;
+            tstrM2MIPConfig lease;
+
+            // The lease was cached for another network than the WINC picked
+            if (cachedLease && !WIFI_CACHE_getLease(info->acSSID, &lease))
+            {
+                debug_printError("WIFI: cached address not valid here, reconnecting with DHCP");
+                WIFI_CACHE_invalidateLease();
+                wifi_disconnectFromAp();
+                break;
+            }
+#if CFG_WIFI_FAST_RECONNECT
+            WIFI_CACHE_store(info->acSSID, (connectChannel != M2M_WIFI_CH_ALL) ? connectChannel : 0,
+                             presetAddress ? NULL : &ipConfig);
+#endif
+            break;
+        }
+
+        case M2M_WIFI_RESP_IP_CONFLICT:
+        {
+            debug_printError("WIFI: IP address conflict");
+            WIFI_CACHE_invalidateLease();
+            // Not with a static address: it would conflict again
+            if (!presetAddress || cachedLease)
+            {
+                wifi_disconnectFromAp();
+            }
+            break;
+        }
+
+        case M2M_WIFI_RESP_SCAN_DONE:
+        {
+            tstrM2mScanDone *scan = (tstrM2mScanDone *)pMsg;
+
+            scanCount = (scan->s8ScanState == M2M_SUCCESS) ? scan->u8NumofCh : 0;
+            scanIndex = 0;
+            nextScanResult();
+            break;
+        }
+
+        case M2M_WIFI_RESP_SCAN_RESULT:
+        {
+            tstrM2mWifiscanResult *result = (tstrM2mWifiscanResult *)pMsg;
+
+            if ((strncmp((char *)result->au8SSID, ssid, M2M_MAX_SSID_LEN) == 0) && (result->s8rssi > scanRssi))
+            {
+                scanRssi = result->s8rssi;
+                scanChannel = result->u8ch;
             }
+            nextScanResult();
             break;
         }
 
@@ -266,7 +632,7 @@ static void wifiCallback(uint8_t msgType, void *pMsg)
                 theTime.tm_mday = WINCTime->u8Day;
                 theTime.tm_isdst = 0;
 
-                set_system_time(mktime(&theTime));
+                TIME_sync(mktime(&theTime));
                 // compare internal and updated time
 //                debug_print("RTC=%ld, NTP=%ld\n", timeNow, time(NULL));
             }
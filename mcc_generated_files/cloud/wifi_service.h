@@ -46,5 +46,44 @@ void wifi_init(void (*funcPtr)(uint8_t), uint8_t  mode);
 void wifi_reinit();
 bool wifi_connectToAp(uint8_t passed_wifi_creds);
 bool wifi_disconnectFromAp(void);
+// Stop the WINC tasks and power the WINC down (CHIP_EN and RESET_N low).
+// wifi_reinit() powers it up again, wifi_wake() restarts the tasks.
+void wifi_sleep(void);
+void wifi_wake(void);
+
+typedef struct
+{
+   uint16_t count;
+   uint32_t last;
+   uint32_t max;
+   uint32_t total;
+} wifiLatencyStats_t;
+
+typedef struct
+{
+   wifiLatencyStats_t latency;      // us, WINC interrupt to m2m_wifi_handle_events()
+   uint16_t missedEdges;            // interrupts found from the IRQ line instead
+   uint16_t polls;
+   uint16_t idlePolls;              // polls that found nothing to handle
+} wifiEventStats_t;
+
+// Called from the main loop: handle the WINC events as soon as its interrupt
+// fires (CFG_WIFI_IRQ_EVENTS), the periodic poll is then only a fallback
+void wifi_handleEvents(void);
+const wifiEventStats_t *wifi_getEventStats(void);
+
+typedef struct
+{
+   uint16_t directed;               // associations tried on the cached channel only
+   uint16_t fallbacks;              // of those failed, retried after a scan of all channels
+   uint16_t scans;                  // of all channels, by the host
+   uint16_t presetAddresses;        // connections without DHCP: static address or cached lease
+   uint16_t addresses;              // addresses got, times below recorded
+   uint32_t lastAssociationMs;      // connect request to association
+   uint32_t lastAddressMs;          // association to IP address
+   uint32_t totalAddressMs;
+} wifiConnectStats_t;
+
+const wifiConnectStats_t *wifi_getConnectStats(void);
 #endif /* WIFI_SERVICE_H_ */
 
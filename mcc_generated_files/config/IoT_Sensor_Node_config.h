@@ -1,7 +1,42 @@
 #ifndef IOT_SENSOR_NODE_CONFIG_H
 #define IOT_SENSOR_NODE_CONFIG_H
 
-#define CFG_SEND_INTERVAL 1
+#define CFG_SEND_INTERVAL 1             // seconds between sensor samples
+#define CFG_PUBLISH_INTERVAL 10         // seconds between aggregated reports
+
+// A change of this size from the last report (0 = off), or crossing the
+// threshold (TELEMETRY_NO_THRESHOLD = off), publishes right away
+#define CFG_LIGHT_DEADBAND 100          // ADC counts
+#define CFG_LIGHT_THRESHOLD TELEMETRY_NO_THRESHOLD
+#define CFG_TEMP_DEADBAND 100           // 1/100 degC
+#define CFG_TEMP_THRESHOLD TELEMETRY_NO_THRESHOLD
+
+// 1 = publish timestamped samples in batches, 0 = one (aggregated) report at a time
+#define CFG_TELEMETRY_BATCH 0
+#define CFG_BATCH_SAMPLES 30            // samples held in RAM, a full batch is published
+#define CFG_BATCH_INTERVAL 30           // seconds, oldest sample age that publishes the batch
+#define CFG_BATCH_PAYLOAD_MAX 320       // bytes, leaves room for the topic in the 400 byte MQTT TX buffer
+// Payload encoding: TELEMETRY_ENCODING_JSON, TELEMETRY_ENCODING_CBOR (binary, smaller)
+// or TELEMETRY_ENCODING_DELTA (delta coded batches, smallest)
+#define CFG_TELEMETRY_ENCODING TELEMETRY_ENCODING_JSON
+#define CFG_TELEMETRY_LZ 0              // 1 = LZ pass on delta batches, CFG_BATCH_PAYLOAD_MAX bytes of RAM
+
+// Store-and-forward of the reports due while the cloud is unreachable
+#define CFG_QUEUE_RAM_RECORDS 16        // reports held in RAM (lost on reset)
+#define CFG_QUEUE_EEPROM_RECORDS 8      // reports spilled to EEPROM when the RAM ring is full
+#define CFG_QUEUE_SPILL_INTERVAL 600L   // seconds, at least, between EEPROM writes
+#define CFG_QUEUE_REPLAY_INTERVAL 1000L // ms between replayed reports, live reports go first
+
+#define CFG_RULES_MAX 4                 // local rules, set with "rules.<n>" on the config topic
+
+// Battery mode: 1 = power the WINC down between bursts of held reports, 0 = always connected
+#define CFG_DUTY_CYCLE 0
+#define CFG_DUTY_CYCLE_PERIOD 15        // minutes from wake to wake
+#define CFG_DUTY_CYCLE_AWAKE_MAX 60     // seconds a burst may last, connection included
+// Average supply current awake and asleep (estimates, measure them), for the energy report
+#define CFG_DUTY_CYCLE_SUPPLY_MV 3300L
+#define CFG_DUTY_CYCLE_AWAKE_UA 80000L
+#define CFG_DUTY_CYCLE_SLEEP_UA 2000L
 
 #define CFG_TIMEOUT 5000
 
@@ -9,4 +44,57 @@
 
 #define CFG_ENABLE_CLI 1
 
+#define CFG_NTP_MIN_INTERVAL 32L        // seconds between WINC time queries while the clock drift is learned
+#define CFG_NTP_MAX_INTERVAL 14400L     // seconds between WINC time queries once the clock holds its time
+
+#define CFG_MQTT_RTT_TELEMETRY 0    // 1 = publish the broker round trip time (ms) to the events/link topic
+#define CFG_RTT_SAMPLE_INTERVAL 10      // seconds between round trip time samples
+#define CFG_RTT_PUBLISH_INTERVAL 300    // seconds between round trip time reports
+
+#define CFG_BSD_SEND_CREDITS 2          // sends handed to the WINC per socket before one must complete
+
+// 1 = WINC events handled from the main loop as soon as its interrupt fires,
+// 0 = only polled, every 50 ms. 0 until the "events" latency and idle wake up
+// figures of both settings have been taken on a board.
+#define CFG_WIFI_IRQ_EVENTS 0
+#define CFG_WIFI_POLL_INTERVAL 1000L    // ms, fallback poll with CFG_WIFI_IRQ_EVENTS
+
+// 1 = WINC SPI transfers in buffered mode, back to back bytes, 0 = one byte at a time.
+// 0 until checked on a bench: the first byte is read after the second is queued,
+// only the two level receive buffer keeps that right. "spi" gives the throughput.
+#define CFG_WINC_SPI_BUFFERED 0
+// WINC SPI CRC (command CRC7, data CRC16): 0 = off after init, 1 = always on,
+// 2 = off once a link self-test passes, back on after repeated bus errors.
+// 0, the driver's own behaviour, until the WINC1510 CRC16 parameters and the switch
+// of its protocol register at run time are confirmed on hardware.
+#define CFG_WINC_SPI_CRC 0
+
+// WINC power save (see power_save.h): 1 = mode and listen interval picked from the
+// report and keep alive intervals, woken ahead of each report, 0 = always awake.
+// 0 until the "power" awake time and the board current have been measured with it.
+#define CFG_POWER_SAVE 0
+#define CFG_POWER_SAVE_WAKE_LEAD 100L   // ms the WINC is woken before a report is due
+#define CFG_POWER_SAVE_LISTEN_MAX 10    // beacon periods (~100 ms) the WINC may sleep through
+
+// Fast reconnect (see wifi_cache.h): 1 = association on the cached channel, and no
+// DHCP while the cached lease is in its first half, 0 = the WINC scans, always DHCP.
+// Not measured on a board yet. The passphrase is cleared once connected, so only the
+// connection with just entered credentials can be directed, later ones skip DHCP only.
+#define CFG_WIFI_FAST_RECONNECT 0
+// A static address ("a.b.c.d", with the three below) skips DHCP altogether, "" = DHCP
+#define CFG_WIFI_STATIC_IP ""
+#define CFG_WIFI_STATIC_GATEWAY ""
+#define CFG_WIFI_STATIC_NETMASK ""
+#define CFG_WIFI_STATIC_DNS ""
+
+// MQTT-SN over UDP to a gateway on the local network, for the sensor stream (see mqtt_sn.h)
+#define CFG_MQTT_SN 0
+#define CFG_MQTT_SN_GATEWAY "192.168.1.2"  // IP address, no lookup
+#define CFG_MQTT_SN_PORT 10000          // UDP, on the gateway and on the device
+#define CFG_MQTT_SN_TOPIC_ID 1          // predefined on the gateway for the events topic
+#define CFG_MQTT_SN_QOS 0               // MQTT_SN_QOS_NONE (-1), 0 or 1
+#define CFG_MQTT_SN_KEEP_ALIVE 60       // seconds
+#define CFG_MQTT_SN_RETRY_MS 3000L      // CONNECT, PINGREQ and QoS 1 PUBLISH retransmission
+#define CFG_MQTT_SN_PAYLOAD_MAX 180     // bytes of RAM for the publish datagram
+
 #endif // IOT_SENSOR_NODE_CONFIG_H
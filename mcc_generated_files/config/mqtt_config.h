@@ -31,6 +31,12 @@
 #define CFG_MQTT_HOST "mqtt.googleapis.com"
 #define CFG_MQTT_PORT 443
 #define CFG_MQTT_CONN_TIMEOUT 10
+#define CFG_MQTT_DNS_CACHE_TTL  86400L  // seconds a broker address cached in EEPROM is trusted
+#define CFG_DNS_CACHE_ENTRIES   2       // host names remembered in the EEPROM address cache
+// Broker endpoints {host, port, TLS}, tried in order of measured handshake time
+#define CFG_MQTT_ENDPOINTS      {CFG_MQTT_HOST, CFG_MQTT_PORT, true}, \
+                                {CFG_MQTT_HOST, 8883, true}
+#define CFG_MQTT_ENDPOINT_FAILURE_PENALTY 10000L   // ms added to an endpoint cost per failed connection
 #define TOPIC_SIZE				100	//Defines the topic length that is supported when we process a published packet 
 #define PAYLOAD_SIZE            200	//Defines the payload size that is supported when we process a published packet
 #define NUM_TOPICS_SUBSCRIBE	1   //Defines number of topics which can be subscribed
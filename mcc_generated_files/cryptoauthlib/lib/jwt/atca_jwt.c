@@ -29,7 +29,7 @@
 #include "../basic/atca_helpers.h"
 #include "../crypto/atca_crypto_sw_sha2.h"
 #include "../jwt/atca_jwt.h"
-#include <stdio.h>
+#include "../../../utils/text_writer.h"
 
 /** \brief The only supported JWT format for this library */
 static const char g_jwt_header[] = "{\"alg\":\"ES256\",\"typ\":\"JWT\"}";
@@ -209,8 +209,7 @@ ATCA_STATUS atca_jwt_finalize(
 
 /**
  * \brief Add a string claim to a token
- * \note This function does not escape strings so the user has to ensure they
- *       are valid for use in a JSON string first
+ * \note The claim name and value are escaped as JSON strings
  */
 ATCA_STATUS atca_jwt_add_claim_string(
     atca_jwt_t* jwt,    /**< [in] JWT Context to use */
@@ -218,16 +217,19 @@ ATCA_STATUS atca_jwt_add_claim_string(
     const char* value   /**< [in] Null terminated string to be insterted */
     )
 {
-    int32_t written;
-    int32_t remaining;
+    uint16_t written;
+    textWriter_t text;
 
     if (jwt && jwt->buf && jwt->buflen && claim && value)
     {
         atca_jwt_check_payload_start(jwt);
 
-        remaining = jwt->buflen - jwt->cur;
-        written = snprintf(&jwt->buf[jwt->cur], remaining, "\"%s\":\"%s\"", claim, value);
-        if (0 < written && written < remaining)
+        TEXT_init(&text, &jwt->buf[jwt->cur], jwt->buflen - jwt->cur);
+        TEXT_putJsonString(&text, claim);
+        TEXT_putChar(&text, ':');
+        TEXT_putJsonString(&text, value);
+        written = TEXT_length(&text);
+        if (0 < written)
         {
             jwt->cur += written;
             return ATCA_SUCCESS;
@@ -245,8 +247,7 @@ ATCA_STATUS atca_jwt_add_claim_string(
 
 /**
  * \brief Add a numeric claim to a token
- * \note This function does not escape strings so the user has to ensure the
- *       claim is valid first
+ * \note The claim name is escaped as a JSON string
  */
 ATCA_STATUS atca_jwt_add_claim_numeric(
     atca_jwt_t* jwt,    /**< [in] JWT Context to use */
@@ -254,16 +255,19 @@ ATCA_STATUS atca_jwt_add_claim_numeric(
     int32_t     value   /**< [in] integer value to be inserted */
     )
 {
-    int32_t written;
-    int32_t remaining;
+    uint16_t written;
+    textWriter_t text;
 
     if (jwt && jwt->buf && jwt->buflen && claim)
     {
         atca_jwt_check_payload_start(jwt);
 
-        remaining = jwt->buflen - jwt->cur;
-        written = snprintf(&jwt->buf[jwt->cur], remaining, "\"%s\":%ld", claim, (long)value);
-        if (0 < written && written < remaining)
+        TEXT_init(&text, &jwt->buf[jwt->cur], jwt->buflen - jwt->cur);
+        TEXT_putJsonString(&text, claim);
+        TEXT_putChar(&text, ':');
+        TEXT_putInt(&text, value);
+        written = TEXT_length(&text);
+        if (0 < written)
         {
             jwt->cur += written;
             return 0;
@@ -27,8 +27,6 @@
 #include "../mcc.h"
 #include "timeout.h"
 
-#define SCHEDULER_BASE_PERIOD 8    // ms
-
 timerStruct_t *listHead          = NULL;
 timerStruct_t * volatile dueHead = NULL;
 
@@ -70,7 +68,7 @@ void timeout_initialize(void)
 
     // Wait for PIT register synchronization
     while (RTC.PITSTATUS > 0);
-    RTC.PITCTRLA = RTC_PERIOD_CYC8_gc;  // 8 msec match SCHEDULER_BASE_PERIOD
+    RTC.PITCTRLA = RTC_PERIOD_CYC8_gc;  // 7.8125 msec, SCHEDULER_BASE_PERIOD units
 
     // Wait for PIT register synchronization
 	while (RTC.PITSTATUS > 0);
@@ -206,6 +204,11 @@ inline void timeout_next(void)
     }
 }
 
+bool timeout_isIdle(void)
+{
+    return (dueHead == NULL);
+}
+
 // This function queues a task with a given period/duration
 // If the task was already active/running it will be replaced by this and the
 //    old (active) task will be removed/cancelled first
@@ -229,6 +232,28 @@ bool timeout_create(timerStruct_t *timer, uint32_t ms)
     return true;    // successful creation
 }
 
+ticks timeout_getTime(void)
+{
+    ticks now;
+
+    // currTime is 16-bit, guard against a PIT update between the two byte reads
+    RTC_DisablePITInterrupt();
+    now = currTime;
+    RTC_EnablePITInterrupt();
+    return now;
+}
+
+// A scheduler unit is 1000/1024 ms (see timeout_getTime())
+uint16_t timeout_toMs(ticks elapsed)
+{
+    return ((uint32_t)elapsed * 125) >> 7;
+}
+
+uint32_t timeout_toUs(ticks elapsed)
+{
+    return ((uint32_t)elapsed * 15625) >> 4;
+}
+
 // NOTE: assumes the callback completes before the next timer tick
 void timeout_isr(void)
 {
@@ -38,6 +38,7 @@
 /** Datatype used to hold the number of ticks until a timer expires */
 typedef uint16_t ticks;
 #define MAX_BASE_PERIOD     32767   // related to ticks definition (16 or 32-bit)
+#define SCHEDULER_BASE_PERIOD 8     // units (1000/1024 ms) per RTC PIT interrupt
 
 /** Typedef for the function pointer for the timeout callback function */
 typedef uint32_t (*timercallback_ptr_t)(void *payload);
@@ -100,5 +101,36 @@ void timeout_flush(void);
  */
 void timeout_next(void);
 
+/**
+ * \brief Check whether a timer task is waiting to be executed
+ *
+ * Call with interrupts disabled to decide whether the CPU can sleep until the
+ * next timer tick.
+ *
+ * \return True if timeout_next() has nothing to execute
+ */
+bool timeout_isIdle(void);
+
+/**
+ * \brief Return the scheduler time base
+ *
+ * Useful to measure short intervals (less than MAX_BASE_PERIOD units) by difference.
+ * The unit is not quite a ms: SCHEDULER_BASE_PERIOD are counted per PIT interrupt,
+ * which comes every 8 cycles of the 1.024kHz RTC clock (7.8125ms), so it is 1000/1024
+ * ms. Convert differences with timeout_toMs() or timeout_toUs().
+ *
+ * \return Current time in scheduler units, with SCHEDULER_BASE_PERIOD resolution,
+ *         wrapping around
+ */
+ticks timeout_getTime(void);
+
+/**
+ * \brief Convert a difference of timeout_getTime() values
+ *
+ * \return The interval in ms, or in us
+ */
+uint16_t timeout_toMs(ticks elapsed);
+uint32_t timeout_toUs(ticks elapsed);
+
 
 #endif // __TIMEOUTDRIVER_H
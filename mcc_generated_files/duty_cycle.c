@@ -0,0 +1,162 @@
+/*
+    \file   duty_cycle.c
+
+    \brief  Battery (duty cycled) operating mode source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/sleep.h>
+#include "duty_cycle.h"
+#include "streams.h"
+#include "time_service.h"
+#include "drivers/timeout.h"
+#include "cloud/cloud_service.h"
+#include "cloud/wifi_service.h"
+#include "utils/atomic.h"
+#include "config/IoT_Sensor_Node_config.h"
+#include "debug_print.h"
+
+#define DUTY_TASK_INTERVAL      500L
+// Nothing left to publish for this long ends the burst: lets the last publish
+// leave the MQTT client and a config update come in
+#define DUTY_LINGER_MS          2000L
+
+typedef enum
+{
+   DUTY_CONNECTING,
+   DUTY_BURSTING,
+   DUTY_DISCONNECTING,      // waiting for the WINC to send the disconnections
+   DUTY_ASLEEP
+} dutyState_t;
+
+static uint32_t dutyTask(void *payload);
+static timerStruct_t dutyTimer = {dutyTask};
+
+static dutyState_t state = DUTY_CONNECTING;
+static bool everConnected = false;
+static uint32_t wakeMs;
+static uint32_t sleepMs;
+static uint32_t idleSinceMs;
+static uint32_t samplesAtWake;
+static dutyCycleStats_t stats;
+
+static void powerDown(uint32_t now)
+{
+   uint32_t asleepMs = stats.cycles ? (wakeMs - sleepMs) : 0;
+   uint64_t energy;
+
+   wifi_sleep();
+   sleepMs = now;
+
+   stats.cycles++;
+   stats.lastAwakeMs = now - wakeMs;
+   stats.totalAwakeMs += stats.lastAwakeMs;
+   stats.totalAsleepMs += asleepMs;
+   stats.lastSamples = STREAMS_getSamplesReported() - samplesAtWake;
+   // mV * uA * ms = pJ
+   energy = (uint64_t)CFG_DUTY_CYCLE_SUPPLY_MV
+         * ((uint64_t)CFG_DUTY_CYCLE_AWAKE_UA * stats.lastAwakeMs + (uint64_t)CFG_DUTY_CYCLE_SLEEP_UA * asleepMs);
+   stats.energyPerSampleUj = stats.lastSamples ? (energy / 1000000UL) / stats.lastSamples : 0;
+   debug_printInfo("DUTY: awake %lums, %lu samples, %luuJ/sample", stats.lastAwakeMs, stats.lastSamples,
+                   stats.energyPerSampleUj);
+}
+
+static void wake(uint32_t now)
+{
+   wakeMs = now;
+   samplesAtWake = STREAMS_getSamplesReported();
+   state = DUTY_CONNECTING;
+   CLOUD_wake();
+}
+
+static uint32_t dutyTask(void *payload)
+{
+   uint32_t now = TIME_getMonotonicMs();
+   uint32_t awakeMs = now - wakeMs;
+
+   switch (state)
+   {
+      case DUTY_CONNECTING:
+         if (CLOUD_isConnected())
+         {
+            everConnected = true;
+            STREAMS_flush();
+            idleSinceMs = now;
+            state = DUTY_BURSTING;
+         }
+         else if (everConnected && (awakeMs >= CFG_DUTY_CYCLE_AWAKE_MAX * 1000UL))
+         {
+            debug_printError("DUTY: no connection, back to sleep");
+            stats.failedWakes++;
+            CLOUD_sleep();
+            state = DUTY_DISCONNECTING;
+         }
+         break;
+
+      case DUTY_BURSTING:
+         if (!CLOUD_isConnected() || !STREAMS_isIdle())
+         {
+            idleSinceMs = now;
+         }
+         if ((now - idleSinceMs >= DUTY_LINGER_MS) || (awakeMs >= CFG_DUTY_CYCLE_AWAKE_MAX * 1000UL))
+         {
+            CLOUD_sleep();
+            state = DUTY_DISCONNECTING;
+         }
+         break;
+
+      case DUTY_DISCONNECTING:
+         powerDown(now);
+         state = DUTY_ASLEEP;
+         break;
+
+      case DUTY_ASLEEP:
+         // The period runs from wake to wake
+         if (awakeMs >= CFG_DUTY_CYCLE_PERIOD * 60000UL)
+         {
+            wake(now);
+         }
+         break;
+   }
+   return DUTY_TASK_INTERVAL;
+}
+
+void DUTY_CYCLE_init(void)
+{
+   STREAMS_hold(true);
+   state = DUTY_CONNECTING;
+   wakeMs = TIME_getMonotonicMs();
+   samplesAtWake = STREAMS_getSamplesReported();
+   timeout_create(&dutyTimer, DUTY_TASK_INTERVAL);
+}
+
+void DUTY_CYCLE_idle(void)
+{
+   if (state != DUTY_ASLEEP)
+   {
+      return;
+   }
+   // Sleep only if no timer is due: the check and the sleep must not be
+   // separated by the PIT interrupt, sei takes effect after the next instruction
+   DISABLE_INTERRUPTS();
+   if (timeout_isIdle())
+   {
+      set_sleep_mode(SLEEP_MODE_IDLE);
+      sleep_enable();
+      ENABLE_INTERRUPTS();
+      sleep_cpu();
+      sleep_disable();
+   }
+   ENABLE_INTERRUPTS();
+}
+
+bool DUTY_CYCLE_isAsleep(void)
+{
+   return (state == DUTY_ASLEEP);
+}
+
+const dutyCycleStats_t *DUTY_CYCLE_getStats(void)
+{
+   return &stats;
+}
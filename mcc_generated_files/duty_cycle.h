@@ -0,0 +1,43 @@
+/*
+    \file   duty_cycle.h
+
+    \brief  Battery (duty cycled) operating mode header file.
+
+    With CFG_DUTY_CYCLE the WINC is powered down between bursts. The streams
+    keep sampling on the RTC driven scheduler and hold their reports (see
+    STREAMS_hold()), while the MCU idles between timer ticks. Every
+    CFG_DUTY_CYCLE_PERIOD minutes the WINC is powered up and reconnects, to the
+    broker address cached in EEPROM; the held reports are published as soon as
+    MQTT is connected, and the WINC is powered down again once nothing is left
+    to publish, or after CFG_DUTY_CYCLE_AWAKE_MAX seconds.
+
+    The energy figures are estimates: time awake and asleep weighted by the
+    CFG_DUTY_CYCLE_*_UA average currents, which should be measured on the board.
+*/
+
+#ifndef DUTY_CYCLE_H_
+#define DUTY_CYCLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+   uint16_t cycles;
+   uint16_t failedWakes;            // no connection within CFG_DUTY_CYCLE_AWAKE_MAX
+   uint32_t lastAwakeMs;            // power up to power down, last cycle
+   uint32_t totalAwakeMs;
+   uint32_t totalAsleepMs;
+   uint32_t lastSamples;            // samples published in the last cycle
+   uint32_t energyPerSampleUj;      // last cycle, asleep and awake
+} dutyCycleStats_t;
+
+// Start in the awake state: the first connection is not time limited
+void DUTY_CYCLE_init(void);
+// Called from the main loop: idle the CPU until the next timer tick while asleep
+void DUTY_CYCLE_idle(void);
+bool DUTY_CYCLE_isAsleep(void);
+
+const dutyCycleStats_t *DUTY_CYCLE_getStats(void);
+
+#endif /* DUTY_CYCLE_H_ */
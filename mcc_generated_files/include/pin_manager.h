@@ -259,6 +259,9 @@
 #define CONF_WIFI_M2M_INT_PIN_EnableInterruptForFallingEdge() do { PORTF.PIN2CTRL = (PORTF.PIN2CTRL & ~PORT_ISC_gm) | 0x3 ; } while(0)
 #define CONF_WIFI_M2M_INT_PIN_DisableDigitalInputBuffer() do { PORTF.PIN2CTRL = (PORTF.PIN2CTRL & ~PORT_ISC_gm) | 0x4 ; } while(0)
 #define CONF_WIFI_M2M_INT_PIN_EnableInterruptForLowLevelSensing() do { PORTF.PIN2CTRL = (PORTF.PIN2CTRL & ~PORT_ISC_gm) | 0x5 ; } while(0)
+#define CONF_WIFI_M2M_INT_PIN_IsInterruptEnabled() (PORTF.PIN2CTRL & PORT_ISC_gm)
+#define CONF_WIFI_M2M_INT_PIN_GetInterruptFlag() (VPORTF.INTFLAGS & (0x1 << 2))
+#define CONF_WIFI_M2M_INT_PIN_ClearInterruptFlag() do { VPORTF.INTFLAGS = (0x1 << 2); } while(0)
 
 //get/set LED_RED aliases
 #define LED_RED_SetHigh() do { PORTD_OUTSET = 0x1; } while(0)
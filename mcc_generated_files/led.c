@@ -130,6 +130,21 @@ void LED_holdYellowOn(bool holdHigh)
     timeout_create(&yellow_timer,LEDS_HOLD_INTERVAL);
 }
 
+// Unlike LED_holdYellowOn(), stays until the next call: publish flashes are suppressed while on
+void LED_setYellow(bool on)
+{
+    timeout_delete(&yellow_timer);
+    if (on == true)
+    {
+        LED_YELLOW_SetLow();
+    }
+    else
+    {
+        LED_YELLOW_SetHigh();
+    }
+    ledHeld = on;
+}
+
 void LED_flashRed(void)
 {
    LED_RED_SetLow();
@@ -37,6 +37,7 @@
 void LED_test(void);
 void LED_flashYellow(void);
 void LED_holdYellowOn(bool holdHigh);
+void LED_setYellow(bool on);
 void LED_flashRed(void);
 void LED_blinkingBlue(bool amBlinking);
 void LED_startBlinkingGreen(void);
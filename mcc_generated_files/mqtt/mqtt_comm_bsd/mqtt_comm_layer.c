@@ -30,34 +30,42 @@
 #include "mqtt_comm_layer.h"
 #include "../../config/IoT_Sensor_Node_config.h"
 #include "../mqtt_core/mqtt_core.h"
+#include "../mqtt_rtt/mqtt_rtt.h"
 #include "../../cloud/bsd_adapter/bsdWINC.h"
 #include "../../debug_print.h"
 
 #define TX_BUFF_SIZE 400
-#define RX_BUFF_SIZE 100
+#define RX_RING_SIZE 256        // the socket receive ring, the rx exchange buffer
+#define RX_PACKET_MAX RX_RING_SIZE // longest packet handed to the parser, read in place
 #define USER_LENGTH 0
 #define MQTT_KEEP_ALIVE_TIME 120
 
 static mqttContext mqttConn;
 static uint8_t mqttTxBuff[TX_BUFF_SIZE];
-static uint8_t mqttRxBuff[RX_BUFF_SIZE];
+static uint8_t mqttRxRing[RX_RING_SIZE];
 static int8_t  mqqtSocket = -1;
+// Bytes of a packet too large for the parser still to be thrown away
+static uint32_t rxSkip = 0;
+// Bytes of the packet the parser reads in place, freed on the next call
+static uint16_t rxHeld = 0;
 
 void MQTT_ClientInitialise(void)
 {
 	MQTT_initialiseState();
 	memset(mqttTxBuff, 0 , sizeof(TX_BUFF_SIZE));
-	memset(mqttRxBuff, 0 , sizeof(RX_BUFF_SIZE));
 	mqttConn.mqttDataExchangeBuffers.txbuff.start = mqttTxBuff;
 	mqttConn.mqttDataExchangeBuffers.txbuff.bufferLength = TX_BUFF_SIZE;
 	mqttConn.mqttDataExchangeBuffers.txbuff.currentLocation = mqttConn.mqttDataExchangeBuffers.txbuff.start;
 	mqttConn.mqttDataExchangeBuffers.txbuff.dataLength = 0;
-	mqttConn.mqttDataExchangeBuffers.rxbuff.start = mqttRxBuff;
-	mqttConn.mqttDataExchangeBuffers.rxbuff.bufferLength = RX_BUFF_SIZE;
+	// Also the receive ring of the socket: packets are parsed where they arrive
+	mqttConn.mqttDataExchangeBuffers.rxbuff.start = mqttRxRing;
+	mqttConn.mqttDataExchangeBuffers.rxbuff.bufferLength = RX_RING_SIZE;
 	mqttConn.mqttDataExchangeBuffers.rxbuff.currentLocation = mqttConn.mqttDataExchangeBuffers.rxbuff.start;
 	mqttConn.mqttDataExchangeBuffers.rxbuff.dataLength = 0;
    
    mqttConn.tcpClientSocket = &mqqtSocket;
+   rxSkip = 0;
+   rxHeld = 0;
 }
 
 mqttContext* MQTT_GetClientConnectionInfo()
@@ -74,6 +82,12 @@ bool MQTT_Send(mqttContext *connectionPtr)
 	{
 		ret = true;
 	}
+	else if (BSD_GetErrNo() == EAGAIN)
+	{
+		// Earlier sends not completed yet: the packet stays flagged for the next call
+		debug_print("MQTT: send deferred");
+		return false;
+	}
 	
 	debug_print("MQTT: sendresult (%d)", sendRet);
 	return ret;
@@ -89,8 +103,86 @@ bool MQTT_Close(mqttContext *connectionPtr)
 	return ret;
 }
 
-void MQTT_GetReceivedData(uint8_t *pData, uint8_t len)
+// Fixed header, in the receive ring from start: packet type, then the remaining
+// length in 1 to 4 bytes of 7 bits. Returns the whole packet length, 0 if the
+// header is not complete yet.
+static uint32_t packetLength(const exchangeBuffer *ring, const uint8_t *start, int count)
+{
+   const uint8_t *end = ring->start + ring->bufferLength;
+   uint32_t length = 0;
+   int i;
+
+   for (i = 1; (i < count) && (i <= 4); i++)
+   {
+      uint8_t byte = (start + i < end) ? start[i] : start[i - ring->bufferLength];
+
+      length |= (uint32_t)(byte & 0x7F) << (7 * (i - 1));
+      if ((byte & 0x80) == 0)
+      {
+         return length + i + 1;
+      }
+   }
+   return 0;
+}
+
+bool MQTT_ReceivePacket(mqttContext *connectionPtr)
 {
-	MQTT_ExchangeBufferInit(&mqttConn.mqttDataExchangeBuffers.rxbuff);
-	MQTT_ExchangeBufferWrite(&mqttConn.mqttDataExchangeBuffers.rxbuff, pData, len);
+   exchangeBuffer *rxbuff = &connectionPtr->mqttDataExchangeBuffers.rxbuff;
+   struct pollfd socketPoll = {*connectionPtr->tcpClientSocket, POLLIN, 0};
+   uint8_t *data;
+   uint32_t length;
+   int count;
+
+   if (rxHeld > 0)
+   {
+      BSD_recvRelease(socketPoll.fd, rxHeld);
+      rxHeld = 0;
+   }
+   MQTT_ExchangeBufferInit(rxbuff);
+   // The rest of a packet too large for the parser, with what a full ring lost of it
+   if (rxSkip > 0)
+   {
+      rxSkip -= BSD_recvSkip(socketPoll.fd, rxSkip);
+   }
+   BSD_poll(&socketPoll, 1, 0);
+   if (socketPoll.revents & POLLERR)
+   {
+      // The stream lost bytes one way or the other, packets can no longer be delimited
+      debug_printError("MQTT: stream broken");
+      MQTT_Close(connectionPtr);
+      return false;
+   }
+   if (!(socketPoll.revents & POLLIN) || (rxSkip > 0))
+   {
+      return false;
+   }
+   // The parser reads the packet where the WINC left it, in the receive ring
+   count = BSD_recvInPlace(socketPoll.fd, &data, 5);
+   if (count <= 0)
+   {
+      return false;
+   }
+   length = packetLength(rxbuff, data, count);
+   if ((length == 0) && (count >= 5))
+   {
+      debug_printError("MQTT: malformed packet length");
+      MQTT_Close(connectionPtr);
+      return false;
+   }
+   if (length > RX_PACKET_MAX)
+   {
+      debug_printError("MQTT: %lu byte packet dropped", length);
+      rxSkip = length - BSD_recvSkip(socketPoll.fd, length);
+      return false;
+   }
+   // Only whole packets are handed to the parser
+   if ((length == 0) || (BSD_recvInPlace(socketPoll.fd, &data, length) < (int)length))
+   {
+      return false;
+   }
+   MQTT_RTT_received(BSD_recvTime(socketPoll.fd, length));
+   rxbuff->currentLocation = data;
+   rxbuff->dataLength = length;
+   rxHeld = length;
+   return true;
 }
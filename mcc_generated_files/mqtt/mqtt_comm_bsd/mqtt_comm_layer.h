@@ -48,7 +48,11 @@ typedef struct
 void MQTT_ClientInitialise(void);
 mqttContext* MQTT_GetClientConnectionInfo();
 
+// False if the socket did not take the packet: it may be sent again later
 bool MQTT_Send(mqttContext *connectionPtr);
 bool MQTT_Close(mqttContext *connectionPtr);
-void MQTT_GetReceivedData(uint8_t *pData, uint8_t len);
+// Point the rx exchange buffer at the next whole packet, in place in the socket
+// receive ring (the rx exchange buffer itself), false if none is complete yet.
+// The packet is freed on the next call.
+bool MQTT_ReceivePacket(mqttContext *connectionPtr);
 #endif /* MQTT_COMM_LAYER_H */
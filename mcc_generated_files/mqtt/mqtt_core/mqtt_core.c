@@ -38,6 +38,7 @@ IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
 #include <stdbool.h>
 #include "../../drivers/timeout.h"
 #include "mqtt_core.h"
+#include "../mqtt_rtt/mqtt_rtt.h"
 #include "../mqtt_packetTransfer_interface.h"
 #include "../../config/mqtt_config.h"
 #include "../../config/IoT_Sensor_Node_config.h"
@@ -441,6 +442,11 @@ int32_t MQTT_getConnectionAge() {
    return age;
 }
 
+// The last PUBLISH packet created has not been sent yet: its topic and payload are still in use
+bool MQTT_isPublishPending(void) {
+   return mqttTxFlags.newTxPublishPacket;
+}
+
 static uint32_t checkConnackTimeoutState() {
    connackTimeoutOccured = true; // Mark that timer has executed
    return 0; // Stop the timer
@@ -719,6 +725,7 @@ static bool mqttSendPublish(mqttContext *mqttConnectionPtr) {
          mqttTxFlags.newTxPublishPacket = 0;
          if (txPublishPacket.publishHeaderFlags.qos == 1) {
             mqttRxFlags.newRxPubackPacket = 1;
+            MQTT_RTT_start(MQTT_RTT_PUBACK);
          }
       }
    }
@@ -778,6 +785,7 @@ static void mqttProcessPingresp(mqttContext *mqttConnectionPtr) {
    memset(&txPingrespPacket, 0, sizeof (txPingrespPacket));
 
    MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, &txPingrespPacket.pingFixedHeader.All, sizeof (txPingrespPacket.pingFixedHeader.All));
+   MQTT_RTT_stop(MQTT_RTT_PING);
    // Reload timeout for keepAliveTimer
    // The timeout should be reloaded only if the keepAliveTimer is set
    // to a non-zero value.
@@ -907,6 +915,13 @@ static mqttCurrentState mqttProcessPublish(mqttContext *mqttConnectionPtr) {
    // Variable header
    MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, (uint8_t*) & rxPublishPacket.topicLength, sizeof (rxPublishPacket.topicLength));
    decodedLength -= sizeof (rxPublishPacket.topicLength);
+   // Both are handed over NUL terminated
+   if ((ntohs(rxPublishPacket.topicLength) >= TOPIC_SIZE) || (decodedLength - ntohs(rxPublishPacket.topicLength) >= PAYLOAD_SIZE)) {
+      debug_printError("MQTT: publish dropped, topic %u payload %lu bytes", ntohs(rxPublishPacket.topicLength),
+            decodedLength - ntohs(rxPublishPacket.topicLength));
+      MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff);
+      return CONNECTED;
+   }
    rxPublishPacket.topic = (uint8_t*) mqttTopic;
    MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, rxPublishPacket.topic, ntohs(rxPublishPacket.topicLength));
    decodedLength -= ntohs(rxPublishPacket.topicLength);
@@ -943,6 +958,7 @@ static void mqttProcessPuback(mqttContext *mqttConnectionPtr) {
    MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, &rxPubackPacket.packetIdentifierLSB, sizeof (rxPubackPacket.packetIdentifierLSB));
    if (rxPubackPacket.packetIdentifierLSB == txPublishPacket.packetIdentifierLSB && rxPubackPacket.packetIdentifierMSB == txPublishPacket.packetIdentifierMSB) {
       mqttRxFlags.newRxPubackPacket = 0;
+      MQTT_RTT_stop(MQTT_RTT_PUBACK);
    }
 }
 
@@ -976,10 +992,10 @@ mqttCurrentState MQTT_TransmissionHandler(mqttContext *mqttConnectionPtr) {
             switch (mqttConnectTxSubstate) {
                case SENDPINGREQ:
                   if (pingreqTimeoutOccured == true) {
-                     // Change state for the next timeout to occur correctly
-                     pingreqTimeoutOccured = false;
-                     // Periodic sending of PINGREQ packet
-                     mqttSendPingreq(mqttConnectionPtr);
+                     // Periodic sending of PINGREQ packet. Change state for the next
+                     // timeout to occur correctly, or try again on the next call if
+                     // the socket pushed back
+                     pingreqTimeoutOccured = !mqttSendPingreq(mqttConnectionPtr);
                   }
                   break;
                case SENDPUBLISH:
@@ -1228,6 +1244,7 @@ static bool mqttSendPingreq(mqttContext *mqttConnectionPtr) {
        mqttTxFlags.newTxPingreqPacket = 0;
        // Expect a PINGRESP packet
        mqttRxFlags.newRxPingrespPacket = 1;
+       MQTT_RTT_start(MQTT_RTT_PING);
        // The client expects the server to send a PINGRESP within
        // keepAliveTimer value.
        
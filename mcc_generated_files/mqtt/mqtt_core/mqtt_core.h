@@ -376,6 +376,7 @@ typedef struct
 /***********************MQTT Client definitions*(END)**************************/
 
 int32_t MQTT_getConnectionAge(void);
+bool MQTT_isPublishPending(void);
 bool MQTT_CreateConnectPacket(mqttConnectPacket *newConnectPacket);
 bool MQTT_CreatePublishPacket(mqttPublishPacket *newPublishPacket);
 bool MQTT_CreateSubscribePacket(mqttSubscribePacket *newSubscribePacket);
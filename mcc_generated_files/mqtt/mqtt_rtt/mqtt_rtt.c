@@ -0,0 +1,84 @@
+/*
+    \file   mqtt_rtt.c
+
+    \brief  MQTT round trip time monitor source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mqtt_rtt.h"
+#include "../../drivers/timeout.h"
+#include "../../debug_print.h"
+
+#define EWMA_WEIGHT 8       // alpha = 1/8
+
+static const uint16_t bucketLimits[MQTT_RTT_BUCKETS - 1] = {100, 250, 500, 1000, 2000};
+
+static mqttRttStats_t rttStats[MQTT_RTT_KINDS];
+static ticks requestTime[MQTT_RTT_KINDS];
+static bool pending[MQTT_RTT_KINDS];
+static ticks receiveTime;
+
+void MQTT_RTT_start(mqttRttKind_t kind)
+{
+   requestTime[kind] = timeout_getTime();
+   pending[kind] = true;
+}
+
+void MQTT_RTT_received(ticks arrival)
+{
+   receiveTime = arrival;
+}
+
+void MQTT_RTT_stop(mqttRttKind_t kind)
+{
+   uint8_t bucket = 0;
+   uint16_t rtt;
+   mqttRttStats_t *stats = &rttStats[kind];
+
+   if (!pending[kind])
+   {
+      return;
+   }
+   pending[kind] = false;
+   rtt = receiveTime - requestTime[kind];
+   if ((int16_t)rtt < 0)
+   {
+      rtt = timeout_getTime() - requestTime[kind];  // no data seen since the request
+   }
+   rtt = timeout_toMs(rtt);
+
+   if (stats->samples == 0)
+   {
+      stats->ewmaMs = rtt;
+   }
+   else
+   {
+      stats->ewmaMs = (uint16_t)((int32_t)stats->ewmaMs + (((int32_t)rtt - stats->ewmaMs) / EWMA_WEIGHT));
+   }
+   if (stats->samples < UINT16_MAX)
+   {
+      stats->samples++;
+   }
+   stats->lastMs = rtt;
+
+   while ((bucket < MQTT_RTT_BUCKETS - 1) && (rtt >= bucketLimits[bucket]))
+   {
+      bucket++;
+   }
+   if (stats->histogram[bucket] < UINT16_MAX)
+   {
+      stats->histogram[bucket]++;
+   }
+   debug_print("MQTT: RTT(%d) %ums", kind, rtt);
+}
+
+const mqttRttStats_t *MQTT_RTT_getStats(mqttRttKind_t kind)
+{
+   return &rttStats[kind];
+}
+
+uint16_t MQTT_RTT_getBucketLimit(uint8_t bucket)
+{
+   return (bucket < MQTT_RTT_BUCKETS - 1) ? bucketLimits[bucket] : 0;
+}
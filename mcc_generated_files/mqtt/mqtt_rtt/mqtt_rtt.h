@@ -0,0 +1,47 @@
+/*
+    \file   mqtt_rtt.h
+
+    \brief  MQTT round trip time monitor header file.
+
+    Times PINGREQ -> PINGRESP and QoS 1 PUBLISH -> PUBACK exchanges with the
+    RTC based scheduler time base. The arrival time is the one the BSD adapter
+    took when the WINC delivered the packet (BSD_recvTime()), not when it is
+    parsed, so the polling period of CLOUD_task does not add to the measurement.
+*/
+
+#ifndef MQTT_RTT_H_
+#define MQTT_RTT_H_
+
+#include <stdint.h>
+#include "../../drivers/timeout.h"
+
+typedef enum
+{
+   MQTT_RTT_PING = 0,      // PINGREQ -> PINGRESP
+   MQTT_RTT_PUBACK,        // PUBLISH (QoS 1) -> PUBACK
+   MQTT_RTT_KINDS
+} mqttRttKind_t;
+
+// Histogram buckets: < 100, < 250, < 500, < 1000, < 2000, >= 2000 ms
+#define MQTT_RTT_BUCKETS    6
+
+typedef struct
+{
+   uint16_t samples;
+   uint16_t lastMs;
+   uint16_t ewmaMs;        // exponentially weighted average, alpha = 1/8
+   uint16_t histogram[MQTT_RTT_BUCKETS];
+} mqttRttStats_t;
+
+// A request of the given kind has just been sent
+void MQTT_RTT_start(mqttRttKind_t kind);
+// The response to the pending request of the given kind has been processed
+void MQTT_RTT_stop(mqttRttKind_t kind);
+// The packet about to be parsed arrived at the given timeout_getTime()
+void MQTT_RTT_received(ticks arrival);
+
+const mqttRttStats_t *MQTT_RTT_getStats(mqttRttKind_t kind);
+// Upper bound (ms) of a histogram bucket, 0 for the last (open) one
+uint16_t MQTT_RTT_getBucketLimit(uint8_t bucket);
+
+#endif /* MQTT_RTT_H_ */
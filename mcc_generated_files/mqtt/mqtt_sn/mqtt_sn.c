@@ -0,0 +1,450 @@
+/*
+    \file   mqtt_sn.c
+
+    \brief  MQTT-SN client source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "mqtt_sn.h"
+#include "../../cloud/bsd_adapter/bsdWINC.h"
+#include "../../winc/socket/include/socket.h"
+#include "../../application_manager.h"
+#include "../../time_service.h"
+#include "../../drivers/timeout.h"
+#include "../../config/IoT_Sensor_Node_config.h"
+#include "../../debug_print.h"
+
+#define MQTT_SN_TASK_INTERVAL   100L
+#define MQTT_SN_TRIES           3       // sends of a request before the gateway is deemed gone
+#define MQTT_SN_RECONNECT_MS    10000L  // between connection attempts
+#define MQTT_SN_BIND_MS         5000L   // wait for the WINC to bind the socket
+#define MQTT_SN_CLIENT_ID_MAX   23
+#define MQTT_SN_HEADER_MAX      9       // 3 byte length, type, flags, topic id, message id
+#define MQTT_SN_RX_MAX          16
+
+// Message types
+#define SN_CONNECT              0x04
+#define SN_CONNACK              0x05
+#define SN_PUBLISH              0x0C
+#define SN_PUBACK               0x0D
+#define SN_PINGREQ              0x16
+#define SN_PINGRESP             0x17
+#define SN_DISCONNECT           0x18
+
+// Flags
+#define SN_FLAG_DUP             0x80
+#define SN_FLAG_QOS_SHIFT       5       // QoS -1 is 3
+#define SN_FLAG_CLEAN_SESSION   0x04
+#define SN_TOPIC_PREDEFINED     0x01
+
+#define SN_PROTOCOL_ID          0x01
+#define SN_ACCEPTED             0x00
+#define SN_LONG_LENGTH          0x01    // first byte of a 3 byte length
+
+typedef enum
+{
+   SN_IDLE,                 // no socket
+   SN_BINDING,
+   SN_READY,                // QoS -1 only
+   SN_CONNECTING,
+   SN_CONNECTED
+} snState_t;
+
+// A request sent again until the gateway answers it
+typedef struct
+{
+   uint8_t *packet;
+   uint16_t length;
+   uint8_t answer;          // message type expected, 0 if none
+   uint8_t tries;
+   uint32_t sentMs;
+} snRequest_t;
+
+static uint32_t snTask(void *payload);
+static timerStruct_t snTimer = {snTask};
+
+static snState_t state = SN_IDLE;
+static int8_t snSocket = -1;
+static struct bsd_sockaddr_in gateway;
+static const char *snClientId;
+static bool connectWanted = false;
+static bool rxArmed = false;
+static uint32_t stateMs;            // entering the state, or the last connection attempt
+static uint32_t lastTxMs;
+static uint16_t messageId = 0;     // of the last QoS 1 publish
+
+// CONNECT and PINGREQ
+static uint8_t controlPacket[6 + MQTT_SN_CLIENT_ID_MAX];
+static snRequest_t control = {controlPacket};
+// PUBLISH, kept until the PUBACK at QoS 1
+static uint8_t publishPacket[MQTT_SN_HEADER_MAX + CFG_MQTT_SN_PAYLOAD_MAX];
+static snRequest_t publish = {publishPacket};
+static uint8_t rxPacket[MQTT_SN_RX_MAX];
+
+static mqttSnStats_t stats;
+
+static uint8_t *putUint16(uint8_t *p, uint16_t value)
+{
+   *p++ = value >> 8;
+   *p++ = (uint8_t)value;
+   return p;
+}
+
+static uint8_t *putHeader(uint8_t *p, uint16_t length, uint8_t type)
+{
+   if (length + 2 > UINT8_MAX)
+   {
+      *p++ = SN_LONG_LENGTH;
+      p = putUint16(p, length + 4);
+   }
+   else
+   {
+      *p++ = length + 2;
+   }
+   *p++ = type;
+   return p;
+}
+
+static bool sendPacket(const uint8_t *packet, uint16_t length)
+{
+   if (BSD_sendto(snSocket, packet, length, 0, (struct bsd_sockaddr *)&gateway, sizeof(gateway)) != (int)length)
+   {
+      return false;
+   }
+   stats.bytesOut += length;
+   lastTxMs = TIME_getMonotonicMs();
+   return true;
+}
+
+// Sent again by snTask() until answered
+static void sendRequest(snRequest_t *request, uint16_t length, uint8_t answer)
+{
+   request->length = length;
+   request->answer = answer;
+   request->tries = 1;
+   request->sentMs = TIME_getMonotonicMs();
+   // A send the WINC refuses is a lost datagram: the retry covers it
+   sendPacket(request->packet, length);
+}
+
+static void sendConnect(void)
+{
+   uint8_t idLength = strlen(snClientId);
+   uint8_t *p;
+
+   if (idLength > MQTT_SN_CLIENT_ID_MAX)
+   {
+      idLength = MQTT_SN_CLIENT_ID_MAX;
+   }
+   p = putHeader(controlPacket, 4 + idLength, SN_CONNECT);
+   *p++ = SN_FLAG_CLEAN_SESSION;
+   *p++ = SN_PROTOCOL_ID;
+   p = putUint16(p, CFG_MQTT_SN_KEEP_ALIVE);
+   memcpy(p, snClientId, idLength);
+   sendRequest(&control, p + idLength - controlPacket, SN_CONNACK);
+   state = SN_CONNECTING;
+   stateMs = TIME_getMonotonicMs();
+}
+
+// Back to QoS -1: the next QoS 0 or 1 publish connects again
+static void dropConnection(void)
+{
+   if (state > SN_READY)
+   {
+      state = SN_READY;
+   }
+   control.answer = 0;
+   if (publish.answer)
+   {
+      publish.answer = 0;
+      stats.lost++;
+   }
+}
+
+static void closeSocket(void)
+{
+   dropConnection();
+   if (snSocket >= 0)
+   {
+      BSD_close(snSocket);
+      snSocket = -1;
+   }
+   state = SN_IDLE;
+   rxArmed = false;
+}
+
+// The gateway answer to a request, or anything it sends
+static void received(uint8_t *data, uint8_t length)
+{
+   rxArmed = false;
+   // Short, single byte length messages only
+   if ((length < 2) || (data[0] != length))
+   {
+      return;
+   }
+   switch (data[1])
+   {
+      case SN_CONNACK:
+         if ((control.answer == SN_CONNACK) && (length == 3))
+         {
+            control.answer = 0;
+            if (data[2] == SN_ACCEPTED)
+            {
+               state = SN_CONNECTED;
+               stats.connects++;
+               debug_printInfo("MQTT-SN: connected");
+            }
+            else
+            {
+               state = SN_READY;
+               debug_printError("MQTT-SN: connection refused (%d)", data[2]);
+            }
+         }
+         break;
+      case SN_PUBACK:
+         // Topic id, message id, return code
+         if ((publish.answer == SN_PUBACK) && (length == 7) && (((data[4] << 8) | data[5]) == messageId))
+         {
+            publish.answer = 0;
+            if (data[6] == SN_ACCEPTED)
+            {
+               stats.acked++;
+            }
+            else
+            {
+               stats.lost++;
+               debug_printError("MQTT-SN: publish rejected (%d)", data[6]);
+            }
+         }
+         break;
+      case SN_PINGRESP:
+         if (control.answer == SN_PINGRESP)
+         {
+            control.answer = 0;
+         }
+         break;
+      case SN_DISCONNECT:
+         debug_printError("MQTT-SN: disconnected by the gateway");
+         dropConnection();
+         break;
+      default:
+         break;
+   }
+}
+
+static void openSocket(void)
+{
+   struct bsd_sockaddr_in local;
+
+   snSocket = BSD_socket(PF_INET, BSD_SOCK_DGRAM, 0);
+   if (snSocket < 0)
+   {
+      return;
+   }
+   BSD_setRecvCallback(snSocket, received);
+   // The gateway answers to the port the requests come from
+   memset(&local, 0, sizeof(local));
+   local.sin_family = PF_INET;
+   local.sin_port = BSD_htons(CFG_MQTT_SN_PORT);
+   if (BSD_bind(snSocket, (struct bsd_sockaddr *)&local, sizeof(local)) != BSD_SUCCESS)
+   {
+      closeSocket();
+      return;
+   }
+   state = SN_BINDING;
+   stateMs = TIME_getMonotonicMs();
+}
+
+// Ask the WINC for the next datagram
+static void armReceive(void)
+{
+   struct bsd_sockaddr_in from = {PF_INET};
+   socklen_t fromLength = sizeof(from);
+
+   rxArmed = (BSD_recvfrom(snSocket, rxPacket, sizeof(rxPacket), 0, (struct bsd_sockaddr *)&from, &fromLength) == BSD_SUCCESS);
+}
+
+// True while the request is waiting, false once it is answered or given up on
+static bool retry(snRequest_t *request, uint32_t now)
+{
+   if (request->answer == 0)
+   {
+      return false;
+   }
+   if (now - request->sentMs < CFG_MQTT_SN_RETRY_MS)
+   {
+      return true;
+   }
+   if (request->tries == MQTT_SN_TRIES)
+   {
+      return false;
+   }
+   if (request == &publish)
+   {
+      publishPacket[(publishPacket[0] == SN_LONG_LENGTH) ? 4 : 2] |= SN_FLAG_DUP;
+   }
+   request->tries++;
+   request->sentMs = now;
+   stats.retries++;
+   sendPacket(request->packet, request->length);
+   return true;
+}
+
+static uint32_t snTask(void *payload)
+{
+   uint32_t now = TIME_getMonotonicMs();
+
+   // Without an address, or the BSD layer closed the socket on an error
+   if (!shared_networking_params.haveIPAddress
+         || ((state >= SN_READY) && (BSD_GetSocketState(snSocket) == NOT_A_SOCKET)))
+   {
+      if (state != SN_IDLE)
+      {
+         closeSocket();
+      }
+      return MQTT_SN_TASK_INTERVAL;
+   }
+   switch (state)
+   {
+      case SN_IDLE:
+         openSocket();
+         break;
+      case SN_BINDING:
+         if (BSD_GetSocketState(snSocket) == SOCKET_CONNECTED)
+         {
+            state = SN_READY;
+            stateMs = now - MQTT_SN_RECONNECT_MS;
+         }
+         else if (now - stateMs >= MQTT_SN_BIND_MS)
+         {
+            closeSocket();
+         }
+         break;
+      case SN_READY:
+         if (connectWanted && (now - stateMs >= MQTT_SN_RECONNECT_MS))
+         {
+            sendConnect();
+         }
+         break;
+      case SN_CONNECTING:
+         if (!retry(&control, now) && (state == SN_CONNECTING))
+         {
+            debug_printError("MQTT-SN: no gateway");
+            dropConnection();
+            stateMs = now;
+         }
+         break;
+      case SN_CONNECTED:
+         if (control.answer == SN_PINGRESP)
+         {
+            if (!retry(&control, now))
+            {
+               debug_printError("MQTT-SN: gateway lost");
+               dropConnection();
+               stateMs = now;
+            }
+         }
+         else if (now - lastTxMs >= CFG_MQTT_SN_KEEP_ALIVE * 1000UL)
+         {
+            sendRequest(&control, putHeader(controlPacket, 0, SN_PINGREQ) - controlPacket, SN_PINGRESP);
+         }
+         break;
+   }
+   if ((publish.answer == SN_PUBACK) && !retry(&publish, now))
+   {
+      debug_printError("MQTT-SN: no PUBACK");
+      dropConnection();
+      stateMs = now;
+   }
+   if ((state >= SN_READY) && !rxArmed)
+   {
+      armReceive();
+   }
+   return MQTT_SN_TASK_INTERVAL;
+}
+
+void MQTT_SN_init(const char *clientId)
+{
+   snClientId = clientId;
+   memset(&gateway, 0, sizeof(gateway));
+   gateway.sin_family = PF_INET;
+   gateway.sin_port = BSD_htons(CFG_MQTT_SN_PORT);
+   gateway.sin_addr.s_addr = nmi_inet_addr(CFG_MQTT_SN_GATEWAY);
+   timeout_create(&snTimer, MQTT_SN_TASK_INTERVAL);
+}
+
+void MQTT_SN_reset(void)
+{
+   dropConnection();
+   snSocket = -1;
+   state = SN_IDLE;
+   rxArmed = false;
+}
+
+bool MQTT_SN_isReady(int8_t qos)
+{
+   if (qos == MQTT_SN_QOS_NONE)
+   {
+      return (state >= SN_READY);
+   }
+   connectWanted = true;
+   return (state == SN_CONNECTED);
+}
+
+bool MQTT_SN_isPublishPending(void)
+{
+   return (publish.answer != 0);
+}
+
+bool MQTT_SN_publish(const mqttSnTopic_t *topic, const uint8_t *data, uint16_t len)
+{
+   uint8_t *p;
+
+   if (!MQTT_SN_isReady(topic->qos) || MQTT_SN_isPublishPending())
+   {
+      return false;
+   }
+   if (len > CFG_MQTT_SN_PAYLOAD_MAX)
+   {
+      // Would never fit: do not hold the stream back
+      debug_printError("MQTT-SN: %u byte payload dropped", len);
+      stats.lost++;
+      return true;
+   }
+   p = putHeader(publishPacket, 5 + len, SN_PUBLISH);
+   *p++ = (((uint8_t)topic->qos & 0x03) << SN_FLAG_QOS_SHIFT) | SN_TOPIC_PREDEFINED;
+   p = putUint16(p, topic->id);
+   if (topic->qos == 1)
+   {
+      // Never 0
+      if (++messageId == 0)
+      {
+         messageId = 1;
+      }
+      p = putUint16(p, messageId);
+   }
+   else
+   {
+      p = putUint16(p, 0);
+   }
+   memcpy(p, data, len);
+   p += len;
+
+   if (topic->qos == 1)
+   {
+      sendRequest(&publish, p - publishPacket, SN_PUBACK);
+   }
+   else if (!sendPacket(publishPacket, p - publishPacket))
+   {
+      return false;
+   }
+   stats.publishes++;
+   return true;
+}
+
+const mqttSnStats_t *MQTT_SN_getStats(void)
+{
+   return &stats;
+}
@@ -0,0 +1,57 @@
+/*
+    \file   mqtt_sn.h
+
+    \brief  MQTT-SN client header file.
+
+    Publishes to topic ids predefined on an MQTT-SN (v1.2) gateway, over UDP:
+    no TCP or TLS connection to set up, and a 7 byte header per message. Meant
+    for frequent, loss tolerant telemetry to a gateway on the local network,
+    which forwards it to the broker. There is no TLS: keep the gateway on a
+    trusted network.
+
+    QoS -1 publishes need no connection to the gateway. The first QoS 0 or 1
+    publish connects (CONNECT/CONNACK), the connection is then kept with
+    PINGREQs. A QoS 1 publish is kept and sent again (DUP) every
+    CFG_MQTT_SN_RETRY_MS until its PUBACK, one at a time.
+
+    Only the gateway answers are parsed (CONNACK, PUBACK, PINGRESP, DISCONNECT):
+    nothing is subscribed to, longer datagrams are ignored.
+*/
+
+#ifndef MQTT_SN_H_
+#define MQTT_SN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MQTT_SN_QOS_NONE    (-1)    // "QoS -1": no connection, predefined topics only
+
+typedef struct
+{
+   uint16_t id;                     // topic id predefined on the gateway
+   int8_t qos;                      // MQTT_SN_QOS_NONE, 0 or 1
+} mqttSnTopic_t;
+
+typedef struct
+{
+   uint16_t publishes;              // sent once
+   uint16_t acked;                  // QoS 1 publishes acknowledged by the gateway
+   uint16_t lost;                   // QoS 1 publishes given up on or rejected, oversized ones
+   uint16_t retries;                // CONNECT, PINGREQ and QoS 1 PUBLISH sent again
+   uint16_t connects;
+   uint32_t bytesOut;               // datagram bytes, headers included
+} mqttSnStats_t;
+
+// Start the client task: the socket is opened once the WINC has an IP address
+void MQTT_SN_init(const char *clientId);
+// The WINC was reset, its sockets are gone
+void MQTT_SN_reset(void);
+// A publish at this QoS can be sent now. Asking for QoS 0 or 1 connects.
+bool MQTT_SN_isReady(int8_t qos);
+// A QoS 1 publish waits for its PUBACK
+bool MQTT_SN_isPublishPending(void);
+// False if it cannot be sent now: try again later. The data is copied.
+bool MQTT_SN_publish(const mqttSnTopic_t *topic, const uint8_t *data, uint16_t len);
+const mqttSnStats_t *MQTT_SN_getStats(void);
+
+#endif /* MQTT_SN_H_ */
@@ -0,0 +1,178 @@
+/*
+    \file   power_save.c
+
+    \brief  WINC power save manager source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "power_save.h"
+#include "streams.h"
+#include "time_service.h"
+#include "drivers/timeout.h"
+#include "winc/driver/include/m2m_wifi.h"
+#include "winc/driver/source/m2m_hif.h"
+#include "winc/bsp/include/nm_bsp_mega.h"
+#include "config/IoT_Sensor_Node_config.h"
+#include "config/mqtt_config.h"
+#include "debug_print.h"
+
+#define SHORTER(a, b)           (((a) < (b)) ? (a) : (b))
+
+// Seconds between reports, on schedule
+#if CFG_TELEMETRY_BATCH
+#define PUBLISH_SECONDS         SHORTER(CFG_BATCH_INTERVAL, CFG_BATCH_SAMPLES * CFG_SEND_INTERVAL)
+#else
+#define PUBLISH_SECONDS         CFG_PUBLISH_INTERVAL
+#endif
+// Seconds between sends, at most: reports or keep alives
+#if CFG_MQTT_SN
+#define SEND_SECONDS            SHORTER(SHORTER(PUBLISH_SECONDS, CFG_MQTT_CONN_TIMEOUT), CFG_MQTT_SN_KEEP_ALIVE)
+#else
+#define SEND_SECONDS            SHORTER(PUBLISH_SECONDS, CFG_MQTT_CONN_TIMEOUT)
+#endif
+
+// Sending more often, the lighter mode wakes up faster
+#define DEEP_MIN_SECONDS        5
+// A quarter of the send interval, in ~100 ms beacon periods
+#define LISTEN_INTERVAL         (SEND_SECONDS * 10 / 4)
+// Timer period limit, a far wake up is reached in steps
+#define WAIT_MAX_MS             30000L
+
+static uint32_t powerTask(void *payload);
+static timerStruct_t powerTimer = {powerTask};
+static uint32_t sampleTask(void *payload);
+static timerStruct_t sampleTimer = {sampleTask};
+
+static bool initialized = false;
+static bool active = false;         // power save on, the HIF is up
+static bool held = false;           // woken by powerTask(), not released yet
+static uint32_t initMs;
+static uint32_t initAwakeMs;
+static uint32_t sampleMs;
+static uint32_t sampleAwakeMs;
+static powerSaveStats_t stats;
+
+// Wake the chip ahead of the next report expected, release it after
+static uint32_t powerTask(void *payload)
+{
+   uint32_t now = TIME_getMonotonicMs();
+   uint32_t reportMs;
+   int32_t ms;
+
+   if (held)
+   {
+      hif_chip_sleep();
+      held = false;
+   }
+   if (!STREAMS_getNextReportMs(&reportMs))
+   {
+      return 0;
+   }
+   ms = (int32_t)(reportMs - now) - CFG_POWER_SAVE_WAKE_LEAD;
+   if (ms > 0)
+   {
+      return (ms > WAIT_MAX_MS) ? WAIT_MAX_MS : ms;
+   }
+   if (hif_chip_wake() != M2M_SUCCESS)
+   {
+      return 0;
+   }
+   held = true;
+   stats.proactiveWakes++;
+   return CFG_POWER_SAVE_WAKE_LEAD + POWER_SAVE_HOLD_MS;
+}
+
+static uint32_t sampleTask(void *payload)
+{
+   uint32_t now = TIME_getMonotonicMs();
+   tstrNmBspAwake awake;
+
+   nm_bsp_get_awake(&awake);
+   if (now != sampleMs)
+   {
+      stats.lastAwakeMsPerMin = (uint64_t)(awake.u32AwakeMs - sampleAwakeMs) * 60000UL / (now - sampleMs);
+   }
+   sampleMs = now;
+   sampleAwakeMs = awake.u32AwakeMs;
+   return POWER_SAVE_SAMPLE_MS;
+}
+
+void POWER_SAVE_init(void)
+{
+   tstrNmBspAwake awake;
+
+   if (initialized)
+   {
+      return;
+   }
+   initialized = true;
+   nm_bsp_get_awake(&awake);
+   initMs = sampleMs = TIME_getMonotonicMs();
+   initAwakeMs = sampleAwakeMs = awake.u32AwakeMs;
+   stats.mode = M2M_NO_PS;
+   timeout_create(&sampleTimer, POWER_SAVE_SAMPLE_MS);
+}
+
+void POWER_SAVE_start(void)
+{
+#if CFG_POWER_SAVE
+   tstrM2mLsnInt listen = {0};
+
+   if (!initialized || active)
+   {
+      return;
+   }
+   stats.mode = (SEND_SECONDS < DEEP_MIN_SECONDS) ? M2M_PS_H_AUTOMATIC : M2M_PS_DEEP_AUTOMATIC;
+   stats.listenInterval = SHORTER(LISTEN_INTERVAL, CFG_POWER_SAVE_LISTEN_MAX);
+   listen.u16LsnInt = stats.listenInterval;
+   // Broadcasts still received: ARP requests for the device address are broadcasts
+   if ((m2m_wifi_set_sleep_mode(stats.mode, 1) != M2M_SUCCESS) || (m2m_wifi_set_lsn_int(&listen) != M2M_SUCCESS))
+   {
+      debug_printError("POWER: power save mode not set");
+      return;
+   }
+   active = true;
+   debug_printInfo("POWER: mode %u, listen interval %u", stats.mode, stats.listenInterval);
+#endif
+}
+
+void POWER_SAVE_stop(bool chipReset)
+{
+   timeout_delete(&powerTimer);
+   if (held)
+   {
+      hif_chip_sleep();
+      held = false;
+   }
+   active = false;
+   if (chipReset)
+   {
+      stats.mode = M2M_NO_PS;
+   }
+}
+
+void POWER_SAVE_reschedule(void)
+{
+   // While held, powerTask() looks for the next report on release
+   if (active && !held)
+   {
+      timeout_create(&powerTimer, 1);
+   }
+}
+
+const powerSaveStats_t *POWER_SAVE_getStats(void)
+{
+   uint32_t elapsedMs = TIME_getMonotonicMs() - initMs;
+   tstrNmBspAwake awake;
+
+   nm_bsp_get_awake(&awake);
+   stats.wakes = awake.u16Wakes;
+   stats.wakeUsAvg = awake.u16Wakes ? awake.u32WakeUs / awake.u16Wakes : 0;
+   stats.wakeUsMax = awake.u32WakeUsMax;
+   if (initialized && elapsedMs)
+   {
+      stats.awakeMsPerMin = (uint64_t)(awake.u32AwakeMs - initAwakeMs) * 60000UL / elapsedMs;
+   }
+   return &stats;
+}
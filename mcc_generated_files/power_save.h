@@ -0,0 +1,57 @@
+/*
+    \file   power_save.h
+
+    \brief  WINC power save manager header file.
+
+    Once the WINC has an IP address it is put in an automatic power save mode,
+    picked from the configured send intervals (reports and MQTT keep alives):
+    M2M_PS_H_AUTOMATIC when something is sent every few seconds, the deeper
+    M2M_PS_DEEP_AUTOMATIC otherwise. Its listen interval, the beacon periods it
+    may sleep through, is about a quarter of the shortest send interval (up to
+    CFG_POWER_SAVE_LISTEN_MAX): a frame from the broker waits that long at most.
+
+    The host wakes the chip for every HIF access, so a publish would pay the
+    wake up time. When the next sample of a stream will make a report due (see
+    STREAMS_getNextReportMs()), the chip is woken CFG_POWER_SAVE_WAKE_LEAD ms
+    before that sample instead, and held awake until POWER_SAVE_HOLD_MS after
+    it, to also get the broker acknowledgment right away.
+
+    The time the host had the WINC awake (see nm_bsp_get_awake()) is sampled
+    every POWER_SAVE_SAMPLE_MS, as ms per minute: an average current proxy,
+    kept with CFG_POWER_SAVE off too, for comparison (always awake then).
+*/
+
+#ifndef POWER_SAVE_H_
+#define POWER_SAVE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define POWER_SAVE_HOLD_MS      500L
+#define POWER_SAVE_SAMPLE_MS    30000L
+
+typedef struct
+{
+   uint8_t mode;                    // tenuPowerSaveModes, M2M_NO_PS until set
+   uint16_t listenInterval;         // beacon periods
+   uint16_t proactiveWakes;         // ahead of a report
+   uint16_t wakes;                  // out of power save sleep, by the host, proactive ones included
+   uint32_t wakeUsAvg;              // chip wake up time
+   uint32_t wakeUsMax;
+   uint32_t lastAwakeMsPerMin;      // over the last POWER_SAVE_SAMPLE_MS
+   uint32_t awakeMsPerMin;          // since POWER_SAVE_init()
+} powerSaveStats_t;
+
+// Start sampling the awake time: the WINC is used as a station from now on
+void POWER_SAVE_init(void);
+// The WINC has an IP address: set its power save mode
+void POWER_SAVE_start(void);
+// The connection is lost, or the WINC is about to be reset or powered down
+// (chipReset: its power save mode is lost): release the chip
+void POWER_SAVE_stop(bool chipReset);
+// The next report expected from the streams changed
+void POWER_SAVE_reschedule(void);
+
+const powerSaveStats_t *POWER_SAVE_getStats(void);
+
+#endif /* POWER_SAVE_H_ */
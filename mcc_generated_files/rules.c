@@ -0,0 +1,261 @@
+/*
+    \file   rules.c
+
+    \brief  Local rule engine source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include "rules.h"
+#include "streams.h"
+#include "time_service.h"
+#include "utils/json_config.h"
+#include "utils/text_writer.h"
+#include "config/IoT_Sensor_Node_config.h"
+#include "debug_print.h"
+
+#define RULES_MAGIC     0x3C
+#define RULE_FREE       0xFF
+#define RULE_TEXT_MAX   24      // JSON_CONFIG_VALUE_MAX: longest rule from the config topic
+
+typedef struct
+{
+   uint8_t  stream;         // RULE_FREE if the slot is free
+   uint8_t  channel;
+   char     op;             // '<' or '>'
+   uint8_t  output;
+   bool     level;          // output level while the condition holds
+   uint16_t holdMs;
+   int32_t  value;          // in the channel fixed point units
+} rule_t;
+
+typedef struct
+{
+   bool     holding;
+   bool     fired;
+   uint32_t sinceMs;        // the condition holds since
+} ruleState_t;
+
+static uint8_t EEMEM eepromMagic;
+static rule_t EEMEM eepromRules[CFG_RULES_MAX];
+
+static rule_t rules[CFG_RULES_MAX];
+static ruleState_t states[CFG_RULES_MAX];
+static const ruleOutput_t *outputs;
+static uint8_t outputCount = 0;
+
+static actuationStats_t localStats;
+
+static void record(actuationStats_t *stats, uint32_t latency)
+{
+   stats->count++;
+   stats->last = latency;
+   stats->total += latency;
+   if (latency > stats->max)
+   {
+      stats->max = latency;
+   }
+}
+
+static uint8_t findOutput(const char *name)
+{
+   uint8_t i;
+
+   for (i = 0; i < outputCount; i++)
+   {
+      if (strcmp(outputs[i].name, name) == 0)
+      {
+         return i;
+      }
+   }
+   return RULE_FREE;
+}
+
+// "<channel><op><value>,<holdMs>,<output>=<0|1>"
+static bool parse(const char *text, rule_t *rule)
+{
+   char buffer[RULE_TEXT_MAX];
+   char *op;
+   char *hold;
+   char *output;
+   char *level;
+   int32_t holdMs;
+
+   if (strlen(text) >= sizeof(buffer))
+   {
+      return false;
+   }
+   strcpy(buffer, text);
+   op = strpbrk(buffer, "<>");
+   hold = strchr(buffer, ',');
+   if ((op == NULL) || (hold == NULL) || (hold < op))
+   {
+      return false;
+   }
+   output = strchr(hold + 1, ',');
+   level = output ? strchr(output + 1, '=') : NULL;
+   if (level == NULL)
+   {
+      return false;
+   }
+   rule->op = *op;
+   *op = *hold = *output = *level = '\0';
+
+   if (!STREAMS_findChannel(buffer, &rule->stream, &rule->channel)
+         || !JSON_CONFIG_parseFixed(op + 1, STREAMS_getChannel(rule->stream, rule->channel)->decimals, &rule->value)
+         || !JSON_CONFIG_parseFixed(hold + 1, 0, &holdMs) || (holdMs < 0) || (holdMs > UINT16_MAX))
+   {
+      return false;
+   }
+   rule->holdMs = holdMs;
+   rule->output = findOutput(output + 1);
+   if ((rule->output == RULE_FREE) || (level[1] < '0') || (level[1] > '1') || (level[2] != '\0'))
+   {
+      return false;
+   }
+   rule->level = (level[1] == '1');
+   return true;
+}
+
+static void actuate(const rule_t *rule, bool level, uint16_t startTicks)
+{
+   outputs[rule->output].set(level);
+   record(&localStats, (uint16_t)(TIME_getTicks() - startTicks) / TIME_TICKS_PER_US);
+}
+
+// Let go of the output of a rule that is replaced or cleared
+static void release(uint8_t slot)
+{
+   if (states[slot].fired)
+   {
+      outputs[rules[slot].output].set(!rules[slot].level);
+   }
+   memset(&states[slot], 0, sizeof(ruleState_t));
+}
+
+void RULES_init(const ruleOutput_t *ruleOutputs, uint8_t count)
+{
+   uint8_t i;
+
+   outputs = ruleOutputs;
+   outputCount = count;
+   if (eeprom_read_byte(&eepromMagic) != RULES_MAGIC)
+   {
+      memset(rules, RULE_FREE, sizeof(rules));
+      eeprom_update_block(rules, eepromRules, sizeof(rules));
+      eeprom_update_byte(&eepromMagic, RULES_MAGIC);
+      return;
+   }
+   eeprom_read_block(rules, eepromRules, sizeof(rules));
+   for (i = 0; i < CFG_RULES_MAX; i++)
+   {
+      // Written by a firmware with other channels or outputs
+      if ((STREAMS_getChannel(rules[i].stream, rules[i].channel) == NULL) || (rules[i].output >= outputCount))
+      {
+         rules[i].stream = RULE_FREE;
+      }
+   }
+}
+
+bool RULES_set(uint8_t slot, const char *text)
+{
+   rule_t rule;
+
+   if (slot >= CFG_RULES_MAX)
+   {
+      return false;
+   }
+   // Free slots are erased like RULES_init() does, to compare equal
+   memset(&rule, (*text == '\0') ? RULE_FREE : 0, sizeof(rule_t));
+   if ((*text != '\0') && !parse(text, &rule))
+   {
+      debug_printError("RULES: rule %u malformed", slot);
+      return false;
+   }
+   // The config topic repeats the document on every connection
+   if (memcmp(&rule, &rules[slot], sizeof(rule_t)) == 0)
+   {
+      return true;
+   }
+   release(slot);
+   rules[slot] = rule;
+   eeprom_update_block(&rule, &eepromRules[slot], sizeof(rule_t));
+   debug_printInfo("RULES: rule %u set", slot);
+   return true;
+}
+
+bool RULES_format(uint8_t slot, char *buffer, uint16_t size)
+{
+   const rule_t *rule;
+   const telemetryChannel_t *channel;
+   textWriter_t text;
+
+   if ((slot >= CFG_RULES_MAX) || (rules[slot].stream == RULE_FREE))
+   {
+      return false;
+   }
+   rule = &rules[slot];
+   channel = STREAMS_getChannel(rule->stream, rule->channel);
+   TEXT_init(&text, buffer, size);
+   TEXT_putString(&text, channel->name);
+   TEXT_putChar(&text, rule->op);
+   TEXT_putFixed(&text, rule->value, channel->decimals);
+   TEXT_putChar(&text, ',');
+   TEXT_putUint(&text, rule->holdMs);
+   TEXT_putChar(&text, ',');
+   TEXT_putString(&text, outputs[rule->output].name);
+   TEXT_putChar(&text, '=');
+   TEXT_putChar(&text, rule->level ? '1' : '0');
+   return (TEXT_length(&text) > 0);
+}
+
+void RULES_evaluate(uint8_t stream, const int32_t *values)
+{
+   uint16_t startTicks = TIME_getTicks();
+   uint32_t now = TIME_getMonotonicMs();
+   uint8_t i;
+
+   if (outputCount == 0)
+   {
+      return;     // not loaded yet
+   }
+   for (i = 0; i < CFG_RULES_MAX; i++)
+   {
+      const rule_t *rule = &rules[i];
+      ruleState_t *state = &states[i];
+      int32_t value;
+
+      if (rule->stream != stream)
+      {
+         continue;
+      }
+      value = values[rule->channel];
+      if ((rule->op == '<') ? (value >= rule->value) : (value <= rule->value))
+      {
+         state->holding = false;
+         if (state->fired)
+         {
+            state->fired = false;
+            actuate(rule, !rule->level, startTicks);
+         }
+         continue;
+      }
+      if (!state->holding)
+      {
+         state->holding = true;
+         state->sinceMs = now;
+      }
+      if (!state->fired && (now - state->sinceMs >= rule->holdMs))
+      {
+         state->fired = true;
+         actuate(rule, rule->level, startTicks);
+      }
+   }
+}
+
+const actuationStats_t *RULES_getLocalStats(void)
+{
+   return &localStats;
+}
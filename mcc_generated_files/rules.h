@@ -0,0 +1,55 @@
+/*
+    \file   rules.h
+
+    \brief  Local rule engine header file.
+
+    A small table of rules is evaluated on every sample of every stream, so an
+    output can react to a sensor without a round trip through the cloud: once
+    "<channel> <op> <value>" has held for holdMs, the output is set to the rule
+    level, and back to the opposite level when the condition stops holding.
+    The condition is only checked at the stream sample interval.
+
+    Rules are set as text, typically from the config topic, and kept in EEPROM:
+        "Light<500,2000,led=1"   light below 500 for 2s: led on
+        "Temp>25.5,0,led=0"      above 25.5 degC: led off
+    An empty text clears the rule.
+
+    Local actuation latency (rule evaluated to output set) is measured in us.
+    A cloud command has no link the device can see to the sample it reacts
+    to, so the cloud path is reported as the MQTT round trip instead (see
+    mqtt_rtt.h): the device -> broker -> device part of any cloud actuation,
+    the backend adds to it.
+*/
+
+#ifndef RULES_H_
+#define RULES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+   const char *name;
+   void (*set)(bool level);
+} ruleOutput_t;
+
+typedef struct
+{
+   uint16_t count;
+   uint32_t last;
+   uint32_t max;
+   uint32_t total;
+} actuationStats_t;
+
+// Load the rules kept in EEPROM, once the streams are registered
+void RULES_init(const ruleOutput_t *outputs, uint8_t count);
+// Parse and store the rule of slot (0 to CFG_RULES_MAX - 1), false if malformed
+bool RULES_set(uint8_t slot, const char *text);
+// Write the rule of slot in the RULES_set() syntax, false if the slot is free
+bool RULES_format(uint8_t slot, char *buffer, uint16_t size);
+// Check the rules of the stream against its new sample
+void RULES_evaluate(uint8_t stream, const int32_t *values);
+
+const actuationStats_t *RULES_getLocalStats(void);     // us
+
+#endif /* RULES_H_ */
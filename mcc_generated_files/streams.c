@@ -0,0 +1,384 @@
+/*
+    \file   streams.c
+
+    \brief  Telemetry stream registry source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "streams.h"
+#include "telemetry.h"
+#include "telemetry_queue.h"
+#include "rules.h"
+#include "power_save.h"
+#include "time_service.h"
+#include "drivers/timeout.h"
+#include "cloud/cloud_service.h"
+#include "mqtt/mqtt_sn/mqtt_sn.h"
+#include "config/IoT_Sensor_Node_config.h"
+#include "led.h"
+#include "debug_print.h"
+
+// Longest timer period (the scheduler limit is MAX_BASE_PERIOD ms)
+#define TIMER_SECONDS_MAX   (MAX_BASE_PERIOD / 1000)
+
+static stream_t *streams[STREAMS_MAX];
+static uint8_t streamCount = 0;
+static bool holding = false;
+static uint32_t samplesReported = 0;
+
+// The MQTT client references the payload until it is sent, one report is in flight at a time
+static char reportBuffer[TELEMETRY_PAYLOAD_MAX];
+
+static uint32_t retryTask(void *payload);
+static timerStruct_t retryTimer = {retryTask};
+
+static uint32_t replayTask(void *payload);
+static timerStruct_t replayTimer = {replayTask};
+static bool replaying = false;
+static uint16_t replayCount;            // records replayed since the queue started draining
+static uint32_t replayStartMs;
+static uint16_t replayRate = 0;         // records per minute of the last drain
+
+// The transport of the stream, MQTT or MQTT-SN
+static bool isConnected(const stream_t *stream)
+{
+#if CFG_MQTT_SN
+   if (stream->snTopic)
+   {
+      return MQTT_SN_isReady(stream->snTopic->qos);
+   }
+#endif
+   return CLOUD_isConnected();
+}
+
+// reportBuffer is in use, or the transport of the stream is busy
+static bool isPublishPending(const stream_t *stream)
+{
+#if CFG_MQTT_SN
+   if (stream->snTopic && MQTT_SN_isPublishPending())
+   {
+      return true;
+   }
+#endif
+   return CLOUD_isPublishPending();
+}
+
+static bool publish(const stream_t *stream, int len)
+{
+#if CFG_MQTT_SN
+   if (stream->snTopic)
+   {
+      return MQTT_SN_publish(stream->snTopic, (uint8_t *)reportBuffer, len);
+   }
+#endif
+   return CLOUD_publishData(stream->topicSuffix, (uint8_t *)reportBuffer, len);
+}
+
+static bool publishReport(stream_t *stream)
+{
+   int len;
+
+   if (isPublishPending(stream))
+   {
+      return false;
+   }
+   len = TELEMETRY_formatReport(&stream->telemetry, reportBuffer, sizeof(reportBuffer), stream->encoding);
+   if (len > 0)
+   {
+      if (!publish(stream, len))
+      {
+         return false;
+      }
+      LED_flashYellow();
+      samplesReported += TELEMETRY_getSampleCount(&stream->telemetry);
+   }
+   else
+   {
+      debug_printError("STREAMS: report does not fit");
+   }
+   TELEMETRY_reportSent(&stream->telemetry);
+   return true;
+}
+
+// The report is due but cannot be published: keep its averages for later
+static void queueReport(stream_t *stream)
+{
+   telemetryQueueRecord_t record;
+   uint16_t samples;
+
+   record.stream = stream->index;
+   samples = TELEMETRY_getAverages(&stream->telemetry, record.values);
+   record.samples = (samples > UINT8_MAX) ? UINT8_MAX : samples;
+   record.time = TIME_isSet() ? TIME_now(NULL) : 0;
+   TELEMETRY_QUEUE_push(&record);
+   TELEMETRY_reportSent(&stream->telemetry);
+}
+
+static void updateReplayRate(void)
+{
+   uint32_t elapsed = TIME_getMonotonicMs() - replayStartMs;
+
+   if (elapsed > 0)
+   {
+      replayRate = (replayCount * 60000UL) / elapsed;
+   }
+}
+
+static void startReplay(void)
+{
+   if (!replaying && (TELEMETRY_QUEUE_depth() > 0))
+   {
+      replaying = true;
+      replayCount = 0;
+      replayStartMs = TIME_getMonotonicMs();
+      timeout_create(&replayTimer, CFG_QUEUE_REPLAY_INTERVAL);
+   }
+}
+
+// Publish one queued record per tick, as long as no live report is waiting
+static uint32_t replayTask(void *payload)
+{
+   telemetryQueueRecord_t record;
+   stream_t *stream;
+   uint8_t i;
+   int len;
+
+   if (!TELEMETRY_QUEUE_peek(&record))
+   {
+      replaying = false;
+      return 0;
+   }
+   // Records left in EEPROM by a firmware with other streams are dropped
+   if (record.stream >= streamCount)
+   {
+      TELEMETRY_QUEUE_pop();
+      return CFG_QUEUE_REPLAY_INTERVAL;
+   }
+   stream = streams[record.stream];
+   if (!isConnected(stream))
+   {
+      replaying = false;
+      return 0;
+   }
+   for (i = 0; i < streamCount; i++)
+   {
+      if (streams[i]->pending)
+      {
+         return CFG_QUEUE_REPLAY_INTERVAL;
+      }
+   }
+   if (isPublishPending(stream))
+   {
+      return CFG_QUEUE_REPLAY_INTERVAL;
+   }
+   len = TELEMETRY_formatRecord(&stream->telemetry, record.time, record.samples, record.values,
+                                reportBuffer, sizeof(reportBuffer), stream->encoding);
+   if ((len > 0) && !publish(stream, len))
+   {
+      return CFG_QUEUE_REPLAY_INTERVAL;
+   }
+   TELEMETRY_QUEUE_pop();
+   samplesReported += record.samples;
+   replayCount++;
+   updateReplayRate();
+   return CFG_QUEUE_REPLAY_INTERVAL;
+}
+
+static uint32_t retryTask(void *payload)
+{
+   uint8_t i;
+   bool waiting = false;
+
+   for (i = 0; i < streamCount; i++)
+   {
+      stream_t *stream = streams[i];
+
+      if (!stream->pending)
+      {
+         continue;
+      }
+      if (!isConnected(stream))
+      {
+         stream->pending = false;    // still due: the next sample queues it
+      }
+      // One report per pass: the next one has to wait for this one to be sent
+      else if (!waiting && publishReport(stream))
+      {
+         stream->pending = false;
+      }
+      else
+      {
+         waiting = true;
+      }
+   }
+   return waiting ? STREAMS_RETRY_INTERVAL : 0;
+}
+
+static uint32_t streamTask(void *payload)
+{
+   stream_t *stream = payload;
+   int32_t values[TELEMETRY_MAX_CHANNELS];
+
+   if (--stream->countdown > 0)
+   {
+      return stream->timerSeconds * 1000UL;
+   }
+   stream->countdown = stream->sampleInterval / stream->timerSeconds;
+
+   stream->sample(values);
+   RULES_evaluate(stream->index, values);
+   TELEMETRY_addSample(&stream->telemetry, values);
+   stream->reportExpected = false;
+   if (!isConnected(stream))
+   {
+      if (!holding && TELEMETRY_isReportDue(&stream->telemetry))
+      {
+         queueReport(stream);
+      }
+      return stream->timerSeconds * 1000UL;
+   }
+   if (!stream->pending && TELEMETRY_isReportDue(&stream->telemetry) && !publishReport(stream))
+   {
+      stream->pending = true;
+      timeout_create(&retryTimer, STREAMS_RETRY_INTERVAL);
+   }
+   startReplay();
+   if (TELEMETRY_isReportDueNext(&stream->telemetry))
+   {
+      stream->reportExpected = true;
+      stream->nextSampleMs = TIME_getMonotonicMs() + stream->sampleInterval * 1000UL;
+      POWER_SAVE_reschedule();
+   }
+   return stream->timerSeconds * 1000UL;
+}
+
+bool STREAMS_register(stream_t *stream)
+{
+   uint8_t seconds;
+
+   if ((streamCount == STREAMS_MAX) || (stream->sampleInterval == 0))
+   {
+      return false;
+   }
+   // Longest timer period that divides the sample interval
+   for (seconds = TIMER_SECONDS_MAX; stream->sampleInterval % seconds; seconds--)
+   {
+   }
+   stream->timerSeconds = seconds;
+   stream->index = streamCount;
+   stream->countdown = stream->sampleInterval / seconds;
+   stream->pending = false;
+   stream->reportExpected = false;
+   TELEMETRY_init(&stream->telemetry, stream->channels, stream->channelCount,
+                  stream->sampleInterval, stream->publishInterval);
+
+   stream->timer.callback = streamTask;
+   stream->timer.payload = stream;
+   streams[streamCount++] = stream;
+   return timeout_create(&stream->timer, seconds * 1000UL);
+}
+
+uint16_t STREAMS_getReplayRate(void)
+{
+   return replayRate;
+}
+
+void STREAMS_hold(bool hold)
+{
+   holding = hold;
+}
+
+void STREAMS_flush(void)
+{
+   uint8_t i;
+
+   for (i = 0; i < streamCount; i++)
+   {
+      stream_t *stream = streams[i];
+
+      TELEMETRY_requestReport(&stream->telemetry);
+      if (!stream->pending && TELEMETRY_isReportDue(&stream->telemetry) && !publishReport(stream))
+      {
+         stream->pending = true;
+         timeout_create(&retryTimer, STREAMS_RETRY_INTERVAL);
+      }
+   }
+}
+
+bool STREAMS_isIdle(void)
+{
+   uint8_t i;
+
+   for (i = 0; i < streamCount; i++)
+   {
+      if (streams[i]->pending || TELEMETRY_isReportDue(&streams[i]->telemetry))
+      {
+         return false;
+      }
+   }
+#if CFG_MQTT_SN
+   if (MQTT_SN_isPublishPending())
+   {
+      return false;
+   }
+#endif
+   return !replaying && (TELEMETRY_QUEUE_depth() == 0) && !CLOUD_isPublishPending();
+}
+
+uint32_t STREAMS_getSamplesReported(void)
+{
+   return samplesReported;
+}
+
+bool STREAMS_getNextReportMs(uint32_t *ms)
+{
+   uint32_t now = TIME_getMonotonicMs();
+   bool found = false;
+   uint8_t i;
+
+   for (i = 0; i < streamCount; i++)
+   {
+      const stream_t *stream = streams[i];
+
+      // Not one already past: its sample was taken, or is late
+      if (stream->reportExpected && ((int32_t)(stream->nextSampleMs - now) > 0)
+            && (!found || ((int32_t)(stream->nextSampleMs - *ms) < 0)))
+      {
+         *ms = stream->nextSampleMs;
+         found = true;
+      }
+   }
+   return found;
+}
+
+bool STREAMS_findChannel(const char *name, uint8_t *stream, uint8_t *channel)
+{
+   uint8_t i;
+   uint8_t ch;
+
+   for (i = 0; i < streamCount; i++)
+   {
+      for (ch = 0; ch < streams[i]->channelCount; ch++)
+      {
+         if (strcmp(streams[i]->channels[ch].name, name) == 0)
+         {
+            *stream = i;
+            *channel = ch;
+            return true;
+         }
+      }
+   }
+   return false;
+}
+
+const telemetryChannel_t *STREAMS_getChannel(uint8_t stream, uint8_t channel)
+{
+   if ((stream >= streamCount) || (channel >= streams[stream]->channelCount))
+   {
+      return NULL;
+   }
+   return &streams[stream]->channels[channel];
+}
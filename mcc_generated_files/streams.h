@@ -0,0 +1,83 @@
+/*
+    \file   streams.h
+
+    \brief  Telemetry stream registry header file.
+
+    A stream samples its channels on its own timer, aggregates them (see
+    telemetry.h) and publishes its reports, in its own encoding, to the device
+    events topic followed by its topic suffix. Fast and slow changing signals
+    can so be reported at their own rates.
+
+    When a report is due while another one is still queued, it is retried
+    every STREAMS_RETRY_INTERVAL ms. When it is due while the cloud is not
+    connected, its channel averages are stored (see telemetry_queue.h) and
+    replayed once the cloud is back, one every CFG_QUEUE_REPLAY_INTERVAL ms
+    while no live report is waiting.
+
+    A stream given an MQTT-SN topic publishes to the MQTT-SN gateway over UDP
+    instead (see mqtt_sn.h), its topic suffix is then unused. "Connected" is
+    then the gateway being reachable at the topic QoS.
+*/
+
+#ifndef STREAMS_H_
+#define STREAMS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry.h"
+#include "drivers/timeout.h"
+#include "mqtt/mqtt_sn/mqtt_sn.h"
+
+#define STREAMS_MAX             4
+#define STREAMS_RETRY_INTERVAL  100L    // ms
+
+// Fill values[] with one sample per channel of the stream
+typedef void (*streamSampler_t)(int32_t *values);
+
+typedef struct
+{
+   const char *topicSuffix;         // e.g. "/diag" publishes to /devices/<id>/events/diag
+   streamSampler_t sample;
+   telemetryChannel_t *channels;
+   uint8_t channelCount;
+   uint16_t sampleInterval;         // seconds
+   uint16_t publishInterval;        // seconds
+   telemetryEncoding_t encoding;
+   const mqttSnTopic_t *snTopic;    // NULL: MQTT to the broker
+
+   // Run time state, set up by STREAMS_register()
+   telemetry_t telemetry;
+   timerStruct_t timer;
+   uint8_t index;                   // in the registry, identifies the stream in queued records
+   uint8_t timerSeconds;            // timer period, divides the sample interval
+   uint16_t countdown;              // timer periods to the next sample
+   bool pending;                    // a report is waiting for the MQTT client
+   bool reportExpected;             // the next sample makes a report due, see STREAMS_getNextReportMs()
+   uint32_t nextSampleMs;           // monotonic
+} stream_t;
+
+// Add the stream to the registry and start sampling it
+bool STREAMS_register(stream_t *stream);
+// Queued records replayed per minute, over the last (or current) drain
+uint16_t STREAMS_getReplayRate(void);
+
+// While held, a report due without a cloud connection stays in its stream,
+// aggregating further samples, instead of being queued
+void STREAMS_hold(bool hold);
+// Publish the samples of every stream now, due or not
+void STREAMS_flush(void);
+// Nothing due, pending or queued
+bool STREAMS_isIdle(void);
+// Samples covered by the reports published so far
+uint32_t STREAMS_getSamplesReported(void);
+// Monotonic time of the next sample, of the connected streams, that will make
+// a report due on schedule (a power save wake up, see power_save.h), false if
+// none is known yet
+bool STREAMS_getNextReportMs(uint32_t *ms);
+
+// Look a channel up by name across the registered streams
+bool STREAMS_findChannel(const char *name, uint8_t *stream, uint8_t *channel);
+// NULL if there is no such stream or channel
+const telemetryChannel_t *STREAMS_getChannel(uint8_t stream, uint8_t channel);
+
+#endif /* STREAMS_H_ */
@@ -0,0 +1,608 @@
+/*
+    \file   telemetry.c
+
+    \brief  Telemetry aggregation source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "telemetry.h"
+#include "config/IoT_Sensor_Node_config.h"
+#include "time_service.h"
+#include "utils/cbor_writer.h"
+#include "utils/delta_codec.h"
+#include "utils/text_writer.h"
+#include "debug_print.h"
+
+#define SAMPLES_PER_REPORT(publish, sample)  (((publish) + (sample) - 1) / (sample))
+
+#if CFG_TELEMETRY_BATCH
+#define BATCH_RECORD(telemetry, i)      (&(telemetry)->batch[((telemetry)->batchHead + (i)) % CFG_BATCH_SAMPLES])
+
+// Milliseconds from t0 (the whole second of the oldest record) to the record
+static uint32_t recordDt(const telemetry_t *telemetry, const telemetryRecord_t *record)
+{
+   return record->monoMs - BATCH_RECORD(telemetry, 0)->monoMs + telemetry->batchStartMs;
+}
+
+static uint16_t valueLength(int32_t value, uint8_t decimals)
+{
+   char text[16];
+   textWriter_t json;
+
+   TEXT_init(&json, text, sizeof(text));
+   TEXT_putFixed(&json, value, decimals);
+   return TEXT_length(&json);
+}
+
+// Characters a record takes in the columns: each value, its separator and the dt
+static uint16_t recordLength(const telemetry_t *telemetry, const telemetryRecord_t *record)
+{
+   uint16_t length = valueLength(recordDt(telemetry, record), 0) + 1;
+   uint8_t ch;
+
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      length += valueLength(record->values[ch], telemetry->channels[ch].decimals) + 1;
+   }
+   return length;
+}
+
+// The widest record there can be: a 32-bit dt and the longest values
+static uint16_t maxRecordLength(const telemetry_t *telemetry)
+{
+   uint16_t length = valueLength(INT32_MAX, 0) + 2;
+   uint8_t ch;
+
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      length += valueLength(INT32_MIN, telemetry->channels[ch].decimals) + 1;
+   }
+   return length;
+}
+
+// Length of the JSON batch: {"t0":<t0>,"dt":[...],"<name>":[...]...}, the
+// records are one separator per column short of batchChars
+static uint16_t batchLength(const telemetry_t *telemetry)
+{
+   uint16_t length = 15 + valueLength((int32_t)(telemetry->batchStartSeconds + UNIX_OFFSET), 0)
+                     + telemetry->batchChars - (telemetry->channelCount + 1);
+   uint8_t ch;
+
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      length += strlen(telemetry->channels[ch].name) + 6;
+   }
+   return length;
+}
+
+// Drop the oldest records, t0 moves to the first one left
+static void batchDrop(telemetry_t *telemetry, uint8_t count)
+{
+   uint32_t startMs;
+   uint8_t i;
+
+   if (count >= telemetry->batchCount)
+   {
+      telemetry->batchHead = 0;
+      telemetry->batchCount = 0;
+      telemetry->batchChars = 0;
+      return;
+   }
+   startMs = recordDt(telemetry, BATCH_RECORD(telemetry, count));
+   telemetry->batchStartSeconds += startMs / 1000;
+   telemetry->batchStartMs = startMs % 1000;
+   telemetry->batchHead = (telemetry->batchHead + count) % CFG_BATCH_SAMPLES;
+   telemetry->batchCount -= count;
+   telemetry->batchChars = 0;
+   for (i = 0; i < telemetry->batchCount; i++)
+   {
+      telemetry->batchChars += recordLength(telemetry, BATCH_RECORD(telemetry, i));
+   }
+}
+
+static void batchAdd(telemetry_t *telemetry, const int32_t *values)
+{
+   telemetryRecord_t *record;
+   uint8_t ch;
+
+   if (telemetry->batchCount == CFG_BATCH_SAMPLES)
+   {
+      // Full (reports are not going out): drop the oldest sample
+      batchDrop(telemetry, 1);
+   }
+   // A report formatted before must be formatted again
+   telemetry->batchReported = 0;
+   record = BATCH_RECORD(telemetry, telemetry->batchCount);
+   record->monoMs = TIME_getMonotonicMs();
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      record->values[ch] = values[ch];
+   }
+   if (telemetry->batchCount == 0)
+   {
+      telemetry->batchStartSeconds = TIME_now(&telemetry->batchStartMs);
+   }
+   telemetry->batchCount++;
+   telemetry->batchChars += recordLength(telemetry, record);
+}
+
+static bool isBatchDue(const telemetry_t *telemetry)
+{
+   if (telemetry->batchCount == 0)
+   {
+      return false;
+   }
+   return telemetry->reportNow || (telemetry->batchCount >= CFG_BATCH_SAMPLES)
+         || ((TIME_getMonotonicMs() - BATCH_RECORD(telemetry, 0)->monoMs) >= CFG_BATCH_INTERVAL * 1000UL)
+         // Another sample might not fit the transmit buffer
+         || (batchLength(telemetry) + maxRecordLength(telemetry) > CFG_BATCH_PAYLOAD_MAX);
+}
+
+// The oldest count records: {"t0":<unix seconds>,"dt":[<ms from t0>,...],"Light":[...],"Temp":[...]}
+static int formatBatch(const telemetry_t *telemetry, uint8_t count, char *buffer, uint16_t size)
+{
+   textWriter_t json;
+   uint8_t ch;
+   uint8_t i;
+
+   TEXT_init(&json, buffer, size);
+   TEXT_putString(&json, "{\"t0\":");
+   TEXT_putUint(&json, (uint32_t)(telemetry->batchStartSeconds + UNIX_OFFSET));
+   TEXT_putString(&json, ",\"dt\":[");
+   for (i = 0; i < count; i++)
+   {
+      if (i)
+      {
+         TEXT_putChar(&json, ',');
+      }
+      TEXT_putUint(&json, recordDt(telemetry, BATCH_RECORD(telemetry, i)));
+   }
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      TEXT_putString(&json, "],");
+      TEXT_putJsonString(&json, telemetry->channels[ch].name);
+      TEXT_putString(&json, ":[");
+      for (i = 0; i < count; i++)
+      {
+         if (i)
+         {
+            TEXT_putChar(&json, ',');
+         }
+         TEXT_putFixed(&json, BATCH_RECORD(telemetry, i)->values[ch], telemetry->channels[ch].decimals);
+      }
+   }
+   TEXT_putString(&json, "]}");
+   return TEXT_length(&json);
+}
+
+// Same layout as formatBatch(), as a CBOR map
+static int encodeBatch(const telemetry_t *telemetry, uint8_t count, cborWriter_t *cbor)
+{
+   uint8_t ch;
+   uint8_t i;
+
+   CBOR_openMap(cbor, 2 + telemetry->channelCount);
+   CBOR_putText(cbor, "t0");
+   CBOR_putUint(cbor, (uint32_t)(telemetry->batchStartSeconds + UNIX_OFFSET));
+   CBOR_putText(cbor, "dt");
+   CBOR_openArray(cbor, count);
+   for (i = 0; i < count; i++)
+   {
+      CBOR_putUint(cbor, recordDt(telemetry, BATCH_RECORD(telemetry, i)));
+   }
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      CBOR_putText(cbor, telemetry->channels[ch].name);
+      CBOR_openArray(cbor, count);
+      for (i = 0; i < count; i++)
+      {
+         CBOR_putFixed(cbor, BATCH_RECORD(telemetry, i)->values[ch], telemetry->channels[ch].decimals);
+      }
+   }
+   return CBOR_length(cbor);
+}
+
+// TELEMETRY_DELTA_BATCH, <t0>, <count>, <channels>, {<name>, <decimals>}..., dt series, value series...
+static uint16_t deltaBatch(const telemetry_t *telemetry, uint8_t count, uint8_t *buffer, uint16_t size)
+{
+   deltaWriter_t writer;
+   deltaSeries_t series;
+   uint8_t ch;
+   uint8_t i;
+
+   DELTA_init(&writer, buffer, size);
+   DELTA_putByte(&writer, TELEMETRY_DELTA_BATCH);
+   DELTA_putUvarint(&writer, (uint32_t)(telemetry->batchStartSeconds + UNIX_OFFSET));
+   DELTA_putUvarint(&writer, count);
+   DELTA_putUvarint(&writer, telemetry->channelCount);
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      DELTA_putText(&writer, telemetry->channels[ch].name);
+      DELTA_putByte(&writer, telemetry->channels[ch].decimals);
+   }
+   DELTA_beginSeries(&series, &writer);
+   for (i = 0; i < count; i++)
+   {
+      DELTA_putTime(&series, recordDt(telemetry, BATCH_RECORD(telemetry, i)));
+   }
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      DELTA_beginSeries(&series, &writer);
+      for (i = 0; i < count; i++)
+      {
+         DELTA_putValue(&series, BATCH_RECORD(telemetry, i)->values[ch]);
+      }
+   }
+   return DELTA_length(&writer);
+}
+
+static int compressBatch(const telemetry_t *telemetry, uint8_t count, uint8_t *buffer, uint16_t size)
+{
+#if CFG_TELEMETRY_LZ
+   static uint8_t scratch[CFG_BATCH_PAYLOAD_MAX];
+   uint16_t length = deltaBatch(telemetry, count, scratch, sizeof(scratch));
+   uint16_t packed;
+
+   if ((length == 0) || (size == 0))
+   {
+      return 0;
+   }
+   // The type byte stays in the clear
+   packed = DELTA_compress(scratch + 1, length - 1, buffer + 1, size - 1);
+   if (packed)
+   {
+      buffer[0] = TELEMETRY_DELTA_BATCH_LZ;
+      return packed + 1;
+   }
+   if (length > size)
+   {
+      return 0;
+   }
+   memcpy(buffer, scratch, length);
+   return length;
+#else
+   return deltaBatch(telemetry, count, buffer, size);
+#endif
+}
+
+// The whole batch, or without its newest records should it not fit (the
+// samples are kept for the next one)
+static int writeBatch(telemetry_t *telemetry, char *buffer, uint16_t size, telemetryEncoding_t encoding)
+{
+   uint8_t count;
+   int length = 0;
+
+   for (count = telemetry->batchCount; (count > 0) && (length == 0); count--)
+   {
+      if (encoding == TELEMETRY_ENCODING_DELTA)
+      {
+         length = compressBatch(telemetry, count, (uint8_t *)buffer, size);
+      }
+      else if (encoding == TELEMETRY_ENCODING_CBOR)
+      {
+         cborWriter_t cbor;
+
+         CBOR_init(&cbor, (uint8_t *)buffer, size);
+         length = encodeBatch(telemetry, count, &cbor);
+      }
+      else
+      {
+         length = formatBatch(telemetry, count, buffer, size);
+      }
+      telemetry->batchReported = count;
+   }
+   if ((length > 0) && (telemetry->batchReported < telemetry->batchCount))
+   {
+      debug_printInfo("TELEMETRY: batch too long, %u of %u samples kept for the next one",
+                         telemetry->batchCount - telemetry->batchReported, telemetry->batchCount);
+   }
+   return length;
+}
+#endif
+
+static bool isUrgent(const telemetry_t *telemetry, uint8_t ch, int32_t value)
+{
+   const telemetryChannel_t *channel = &telemetry->channels[ch];
+
+   if (!telemetry->haveReported)
+   {
+      return true;     // first sample after boot
+   }
+   if ((channel->deadband > 0) && (labs(value - telemetry->lastReported[ch]) >= channel->deadband))
+   {
+      return true;
+   }
+   if ((channel->threshold != TELEMETRY_NO_THRESHOLD)
+         && ((telemetry->window[ch].last < channel->threshold) != (value < channel->threshold)))
+   {
+      return true;
+   }
+   return false;
+}
+
+void TELEMETRY_init(telemetry_t *telemetry, telemetryChannel_t *channels, uint8_t channelCount,
+                    uint16_t sampleInterval, uint16_t publishInterval)
+{
+   memset(telemetry, 0, sizeof(telemetry_t));
+   telemetry->channels = channels;
+   telemetry->channelCount = (channelCount < TELEMETRY_MAX_CHANNELS) ? channelCount : TELEMETRY_MAX_CHANNELS;
+   telemetry->sampleInterval = sampleInterval;
+   TELEMETRY_setPublishInterval(telemetry, publishInterval);
+}
+
+void TELEMETRY_addSample(telemetry_t *telemetry, const int32_t *values)
+{
+   uint8_t ch;
+
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      telemetryAggregate_t *agg = &telemetry->window[ch];
+      int32_t value = values[ch];
+
+      if (isUrgent(telemetry, ch, value))
+      {
+         telemetry->reportNow = true;
+      }
+      if ((agg->count == 0) || (value < agg->min))
+      {
+         agg->min = value;
+      }
+      if ((agg->count == 0) || (value > agg->max))
+      {
+         agg->max = value;
+      }
+      agg->last = value;
+      agg->sum += value;
+      agg->count++;
+   }
+#if CFG_TELEMETRY_BATCH
+   batchAdd(telemetry, values);
+#endif
+}
+
+bool TELEMETRY_isReportDue(const telemetry_t *telemetry)
+{
+#if CFG_TELEMETRY_BATCH
+   return isBatchDue(telemetry);
+#else
+   return (telemetry->window[0].count > 0)
+         && (telemetry->reportNow || (telemetry->window[0].count >= telemetry->samplesPerReport));
+#endif
+}
+
+bool TELEMETRY_isReportDueNext(const telemetry_t *telemetry)
+{
+#if CFG_TELEMETRY_BATCH
+   return (telemetry->batchCount + 1 >= CFG_BATCH_SAMPLES)
+         || ((telemetry->batchCount > 0)
+             && ((TIME_getMonotonicMs() - BATCH_RECORD(telemetry, 0)->monoMs + telemetry->sampleInterval * 1000UL)
+                 >= CFG_BATCH_INTERVAL * 1000UL));
+#else
+   return telemetry->window[0].count + 1 >= telemetry->samplesPerReport;
+#endif
+}
+
+void TELEMETRY_requestReport(telemetry_t *telemetry)
+{
+   telemetry->reportNow = true;
+}
+
+uint16_t TELEMETRY_getSampleCount(const telemetry_t *telemetry)
+{
+#if CFG_TELEMETRY_BATCH
+   return telemetry->batchReported ? telemetry->batchReported : telemetry->batchCount;
+#else
+   return telemetry->window[0].count;
+#endif
+}
+
+// "<name><suffix>":<value>, after a ',' unless it is the first field
+static void formatField(textWriter_t *json, const char *name, const char *suffix, int32_t value, uint8_t decimals)
+{
+   if (json->length > 1)
+   {
+      TEXT_putChar(json, ',');
+   }
+   TEXT_putChar(json, '"');
+   TEXT_putString(json, name);
+   TEXT_putString(json, suffix);
+   TEXT_putString(json, "\":");
+   TEXT_putFixed(json, value, decimals);
+}
+
+static void encodeField(cborWriter_t *cbor, const char *name, const char *suffix, int32_t value, uint8_t decimals)
+{
+   char key[16];
+   textWriter_t text;
+
+   TEXT_init(&text, key, sizeof(key));
+   TEXT_putString(&text, name);
+   TEXT_putString(&text, suffix);
+   CBOR_putText(cbor, key);
+   CBOR_putFixed(cbor, value, decimals);
+}
+
+// Same fields as the JSON report, as a CBOR map
+static int encodeReport(const telemetry_t *telemetry, cborWriter_t *cbor)
+{
+   const telemetryChannel_t *channels = telemetry->channels;
+   uint8_t ch;
+   uint8_t pairs = telemetry->channelCount;
+
+   if (telemetry->window[0].count > 1)
+   {
+      pairs += 1 + 3 * telemetry->channelCount;
+   }
+   CBOR_openMap(cbor, pairs);
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      encodeField(cbor, channels[ch].name, "", telemetry->window[ch].last, channels[ch].decimals);
+   }
+   if (telemetry->window[0].count > 1)
+   {
+      CBOR_putText(cbor, "n");
+      CBOR_putUint(cbor, telemetry->window[0].count);
+      for (ch = 0; ch < telemetry->channelCount; ch++)
+      {
+         const telemetryAggregate_t *agg = &telemetry->window[ch];
+
+         encodeField(cbor, channels[ch].name, "_min", agg->min, channels[ch].decimals);
+         encodeField(cbor, channels[ch].name, "_max", agg->max, channels[ch].decimals);
+         encodeField(cbor, channels[ch].name, "_avg", agg->sum / agg->count, channels[ch].decimals);
+      }
+   }
+   return CBOR_length(cbor);
+}
+
+int TELEMETRY_formatReport(telemetry_t *telemetry, char *buffer, uint16_t size, telemetryEncoding_t encoding)
+{
+   const telemetryChannel_t *channels = telemetry->channels;
+   textWriter_t json;
+   uint8_t ch;
+
+#if CFG_TELEMETRY_BATCH
+   return writeBatch(telemetry, buffer, size, encoding);
+#endif
+   if (encoding != TELEMETRY_ENCODING_JSON)
+   {
+      cborWriter_t cbor;
+
+      CBOR_init(&cbor, (uint8_t *)buffer, size);
+      return (telemetry->window[0].count > 0) ? encodeReport(telemetry, &cbor) : 0;
+   }
+   if (telemetry->window[0].count == 0)
+   {
+      return 0;
+   }
+   TEXT_init(&json, buffer, size);
+   TEXT_putChar(&json, '{');
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      formatField(&json, channels[ch].name, "", telemetry->window[ch].last, channels[ch].decimals);
+   }
+   // Aggregates are only meaningful over more than one sample
+   if (telemetry->window[0].count > 1)
+   {
+      formatField(&json, "n", "", telemetry->window[0].count, 0);
+      for (ch = 0; ch < telemetry->channelCount; ch++)
+      {
+         const telemetryAggregate_t *agg = &telemetry->window[ch];
+
+         formatField(&json, channels[ch].name, "_min", agg->min, channels[ch].decimals);
+         formatField(&json, channels[ch].name, "_max", agg->max, channels[ch].decimals);
+         formatField(&json, channels[ch].name, "_avg", agg->sum / agg->count, channels[ch].decimals);
+      }
+   }
+   TEXT_putChar(&json, '}');
+   return TEXT_length(&json);
+}
+
+uint16_t TELEMETRY_getAverages(const telemetry_t *telemetry, int32_t *values)
+{
+   uint8_t ch;
+
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      const telemetryAggregate_t *agg = &telemetry->window[ch];
+
+      values[ch] = agg->count ? agg->sum / agg->count : 0;
+   }
+   return telemetry->window[0].count;
+}
+
+int TELEMETRY_formatRecord(const telemetry_t *telemetry, time_t time, uint16_t samples, const int32_t *values,
+                           char *buffer, uint16_t size, telemetryEncoding_t encoding)
+{
+   const telemetryChannel_t *channels = telemetry->channels;
+   uint8_t ch;
+
+   if (encoding != TELEMETRY_ENCODING_JSON)
+   {
+      cborWriter_t cbor;
+
+      CBOR_init(&cbor, (uint8_t *)buffer, size);
+      CBOR_openMap(&cbor, telemetry->channelCount + (time ? 2 : 1));
+      if (time)
+      {
+         CBOR_putText(&cbor, "t");
+         CBOR_putUint(&cbor, (uint32_t)(time + UNIX_OFFSET));
+      }
+      CBOR_putText(&cbor, "n");
+      CBOR_putUint(&cbor, samples);
+      for (ch = 0; ch < telemetry->channelCount; ch++)
+      {
+         encodeField(&cbor, channels[ch].name, "", values[ch], channels[ch].decimals);
+      }
+      return CBOR_length(&cbor);
+   }
+   else
+   {
+      textWriter_t json;
+
+      TEXT_init(&json, buffer, size);
+      TEXT_putChar(&json, '{');
+      if (time)
+      {
+         formatField(&json, "t", "", (int32_t)(time + UNIX_OFFSET), 0);
+      }
+      formatField(&json, "n", "", samples, 0);
+      for (ch = 0; ch < telemetry->channelCount; ch++)
+      {
+         formatField(&json, channels[ch].name, "", values[ch], channels[ch].decimals);
+      }
+      TEXT_putChar(&json, '}');
+      return TEXT_length(&json);
+   }
+}
+
+void TELEMETRY_setPublishInterval(telemetry_t *telemetry, uint16_t seconds)
+{
+   telemetry->samplesPerReport = SAMPLES_PER_REPORT(seconds, telemetry->sampleInterval);
+   if (telemetry->samplesPerReport == 0)
+   {
+      telemetry->samplesPerReport = 1;
+   }
+}
+
+void TELEMETRY_setDeadband(telemetry_t *telemetry, uint8_t channel, int32_t deadband)
+{
+   if (channel < telemetry->channelCount)
+   {
+      telemetry->channels[channel].deadband = deadband;
+   }
+}
+
+void TELEMETRY_setThreshold(telemetry_t *telemetry, uint8_t channel, int32_t threshold)
+{
+   if (channel < telemetry->channelCount)
+   {
+      telemetry->channels[channel].threshold = threshold;
+   }
+}
+
+void TELEMETRY_reportSent(telemetry_t *telemetry)
+{
+   uint8_t ch;
+
+   for (ch = 0; ch < telemetry->channelCount; ch++)
+   {
+      telemetry->lastReported[ch] = telemetry->window[ch].last;
+      telemetry->window[ch].sum = 0;
+      telemetry->window[ch].count = 0;
+   }
+   telemetry->haveReported = true;
+   telemetry->reportNow = false;
+#if CFG_TELEMETRY_BATCH
+   // All of them unless the batch went out without its newest records
+   batchDrop(telemetry, telemetry->batchReported ? telemetry->batchReported : telemetry->batchCount);
+   telemetry->batchReported = 0;
+#endif
+}
+
+const telemetryAggregate_t *TELEMETRY_getAggregate(const telemetry_t *telemetry, uint8_t channel)
+{
+   return &telemetry->window[channel];
+}
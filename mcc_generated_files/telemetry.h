@@ -0,0 +1,137 @@
+/*
+    \file   telemetry.h
+
+    \brief  Telemetry aggregation header file.
+
+    Each telemetry_t aggregates the samples of a set of channels (min/max/
+    mean/last) until a report is due: every publish interval, or right away
+    when a channel moves by more than its deadband from the last reported
+    value or crosses its threshold.
+
+    With CFG_TELEMETRY_BATCH the individual samples are kept instead, with
+    their timestamps, and published together as one array payload every
+    CFG_BATCH_SAMPLES samples, CFG_BATCH_INTERVAL seconds, or when one more
+    sample as wide as can be could exceed CFG_BATCH_PAYLOAD_MAX. A batch that
+    still does not fit (it could not go out in time) is published without its
+    newest samples, which start the next one.
+
+    Reports are JSON text or, more compactly, a CBOR map with the same keys;
+    values with decimals are CBOR decimal fractions (tag 4).
+
+    TELEMETRY_ENCODING_DELTA packs batches smaller still (see utils/delta_codec.h),
+    all varints: TELEMETRY_DELTA_BATCH, t0 (unix seconds), sample count, channel
+    count, each channel name and decimals byte, the dt series (delta-of-delta),
+    then the series of each channel (deltas, fixed point units). With
+    CFG_TELEMETRY_LZ what follows the first byte may be LZ compressed, the first
+    byte is then TELEMETRY_DELTA_BATCH_LZ. Other reports go out as CBOR, told
+    apart by their first byte (a map). tools/telemetry_codec has the decoder.
+*/
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "config/IoT_Sensor_Node_config.h"
+
+#define TELEMETRY_NO_THRESHOLD  INT32_MIN
+#define TELEMETRY_MAX_CHANNELS  2       // channels per telemetry_t
+
+// Size of the buffer TELEMETRY_formatReport() needs
+#if CFG_TELEMETRY_BATCH
+#define TELEMETRY_PAYLOAD_MAX   (CFG_BATCH_PAYLOAD_MAX + 1)
+#else
+#define TELEMETRY_PAYLOAD_MAX   180
+#endif
+
+typedef enum
+{
+   TELEMETRY_ENCODING_JSON = 0,
+   TELEMETRY_ENCODING_CBOR,
+   TELEMETRY_ENCODING_DELTA        // batches only, CBOR otherwise
+} telemetryEncoding_t;
+
+// First byte of a TELEMETRY_ENCODING_DELTA batch
+#define TELEMETRY_DELTA_BATCH       0xD0
+#define TELEMETRY_DELTA_BATCH_LZ    0xD1
+
+typedef struct
+{
+   const char *name;
+   uint8_t decimals;       // fixed point: the value is in 1/10^decimals units
+   int32_t deadband;       // report right away on a larger change (0 = off)
+   int32_t threshold;      // report right away when crossed (TELEMETRY_NO_THRESHOLD = off)
+} telemetryChannel_t;
+
+typedef struct
+{
+   int32_t  min;
+   int32_t  max;
+   int32_t  last;
+   int32_t  sum;
+   uint16_t count;
+} telemetryAggregate_t;
+
+typedef struct
+{
+   uint32_t monoMs;
+   int32_t  values[TELEMETRY_MAX_CHANNELS];
+} telemetryRecord_t;
+
+typedef struct
+{
+   telemetryChannel_t *channels;   // in RAM: deadband and threshold can be changed at run time
+   uint8_t channelCount;
+   uint16_t sampleInterval;        // seconds
+   uint16_t samplesPerReport;
+   telemetryAggregate_t window[TELEMETRY_MAX_CHANNELS];
+   int32_t lastReported[TELEMETRY_MAX_CHANNELS];
+   bool haveReported;
+   bool reportNow;
+#if CFG_TELEMETRY_BATCH
+   telemetryRecord_t batch[CFG_BATCH_SAMPLES];
+   uint8_t batchHead;              // oldest record
+   uint8_t batchCount;
+   uint16_t batchChars;            // characters the records add to the payload
+   uint8_t batchReported;          // records in the report formatted last, 0 = none
+   time_t batchStartSeconds;       // wall clock of the oldest record
+   uint16_t batchStartMs;
+#endif
+} telemetry_t;
+
+void TELEMETRY_init(telemetry_t *telemetry, telemetryChannel_t *channels, uint8_t channelCount,
+                    uint16_t sampleInterval, uint16_t publishInterval);
+// Add one sample, values indexed like the channels
+void TELEMETRY_addSample(telemetry_t *telemetry, const int32_t *values);
+bool TELEMETRY_isReportDue(const telemetry_t *telemetry);
+// The next sample will make a report due on schedule (deadbands and thresholds aside)
+bool TELEMETRY_isReportDueNext(const telemetry_t *telemetry);
+// Make the current window due, if it holds any sample
+void TELEMETRY_requestReport(telemetry_t *telemetry);
+// Samples the report formatted last covers, or the next one if none
+uint16_t TELEMETRY_getSampleCount(const telemetry_t *telemetry);
+// Write the report of the current window, returns its length (0 if nothing to report
+// or it does not fit). A batch goes without the newest samples that do not fit.
+int TELEMETRY_formatReport(telemetry_t *telemetry, char *buffer, uint16_t size, telemetryEncoding_t encoding);
+// The report was published: start a new window, with the samples a batch left out
+void TELEMETRY_reportSent(telemetry_t *telemetry);
+
+// Store-and-forward (see telemetry_queue.h): while the cloud is unreachable a
+// due report is reduced to the channel averages of its window, returns the
+// number of samples averaged
+uint16_t TELEMETRY_getAverages(const telemetry_t *telemetry, int32_t *values);
+// Write such a record, taken at time (avr-libc seconds, 0 if unknown):
+// {"t":<unix seconds>,"n":<samples>,"<name>":<average>...}
+int TELEMETRY_formatRecord(const telemetry_t *telemetry, time_t time, uint16_t samples, const int32_t *values,
+                           char *buffer, uint16_t size, telemetryEncoding_t encoding);
+
+// Run time overrides of the publish interval and of the channel deadband and
+// threshold (in the channel fixed point units)
+void TELEMETRY_setPublishInterval(telemetry_t *telemetry, uint16_t seconds);
+void TELEMETRY_setDeadband(telemetry_t *telemetry, uint8_t channel, int32_t deadband);
+void TELEMETRY_setThreshold(telemetry_t *telemetry, uint8_t channel, int32_t threshold);
+
+const telemetryAggregate_t *TELEMETRY_getAggregate(const telemetry_t *telemetry, uint8_t channel);
+
+#endif /* TELEMETRY_H_ */
@@ -0,0 +1,169 @@
+/*
+    \file   telemetry_queue.c
+
+    \brief  Store-and-forward telemetry queue source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/eeprom.h>
+#include "telemetry_queue.h"
+#include "time_service.h"
+#include "config/IoT_Sensor_Node_config.h"
+
+#define QUEUE_MAGIC     0x5A
+
+typedef struct
+{
+   uint8_t magic;
+   uint8_t head;        // oldest record
+   uint8_t count;
+} queueHeader_t;
+
+static telemetryQueueRecord_t ramRing[CFG_QUEUE_RAM_RECORDS];
+static uint8_t ramHead = 0;
+
+static queueHeader_t EEMEM eepromHeader;
+static telemetryQueueRecord_t EEMEM eepromRing[CFG_QUEUE_EEPROM_RECORDS];
+static queueHeader_t header;    // RAM copy of eepromHeader
+
+static telemetryQueueStats_t stats;
+static bool haveSpilled = false;
+static uint32_t lastSpillMs;
+
+// eeprom_update_* only rewrites the bytes that change
+static void saveHeader(void)
+{
+   eeprom_update_block(&header, &eepromHeader, sizeof(queueHeader_t));
+}
+
+// Move the oldest RAM record to the EEPROM ring, dropping its oldest record if full
+static void spill(void)
+{
+   uint8_t tail;
+
+   if (header.count == CFG_QUEUE_EEPROM_RECORDS)
+   {
+      header.head = (header.head + 1) % CFG_QUEUE_EEPROM_RECORDS;
+      header.count--;
+      stats.dropped++;
+   }
+   tail = (header.head + header.count) % CFG_QUEUE_EEPROM_RECORDS;
+   eeprom_update_block(&ramRing[ramHead], &eepromRing[tail], sizeof(telemetryQueueRecord_t));
+   header.count++;
+   saveHeader();
+   ramHead = (ramHead + 1) % CFG_QUEUE_RAM_RECORDS;
+   stats.ramDepth--;
+   stats.spilled++;
+   haveSpilled = true;
+   lastSpillMs = TIME_getMonotonicMs();
+}
+
+// Make room in RAM without writing the EEPROM: average the two oldest records
+// into one, or drop the oldest if they come from different streams
+static void merge(void)
+{
+   telemetryQueueRecord_t *oldest = &ramRing[ramHead];
+   telemetryQueueRecord_t *next = &ramRing[(ramHead + 1) % CFG_QUEUE_RAM_RECORDS];
+   uint8_t ch;
+
+   if (oldest->stream == next->stream)
+   {
+      uint16_t samples = oldest->samples + next->samples;
+
+      for (ch = 0; ch < TELEMETRY_MAX_CHANNELS; ch++)
+      {
+         next->values[ch] = ((int64_t)oldest->values[ch] * oldest->samples
+               + (int64_t)next->values[ch] * next->samples) / (samples ? samples : 1);
+      }
+      next->samples = (samples > UINT8_MAX) ? UINT8_MAX : samples;
+      next->time = oldest->time;
+      stats.merged++;
+   }
+   else
+   {
+      stats.dropped++;
+   }
+   ramHead = (ramHead + 1) % CFG_QUEUE_RAM_RECORDS;
+   stats.ramDepth--;
+}
+
+void TELEMETRY_QUEUE_init(void)
+{
+   eeprom_read_block(&header, &eepromHeader, sizeof(queueHeader_t));
+   if ((header.magic != QUEUE_MAGIC) || (header.head >= CFG_QUEUE_EEPROM_RECORDS)
+         || (header.count > CFG_QUEUE_EEPROM_RECORDS))
+   {
+      header.magic = QUEUE_MAGIC;
+      header.head = 0;
+      header.count = 0;
+      saveHeader();
+   }
+   stats.eepromDepth = header.count;
+}
+
+void TELEMETRY_QUEUE_push(const telemetryQueueRecord_t *record)
+{
+   if (stats.ramDepth == CFG_QUEUE_RAM_RECORDS)
+   {
+      // Limit EEPROM wear during long outages
+      if (!haveSpilled || (TIME_getMonotonicMs() - lastSpillMs >= CFG_QUEUE_SPILL_INTERVAL * 1000UL))
+      {
+         spill();
+      }
+      else
+      {
+         merge();
+      }
+   }
+   ramRing[(ramHead + stats.ramDepth) % CFG_QUEUE_RAM_RECORDS] = *record;
+   stats.ramDepth++;
+   stats.eepromDepth = header.count;
+   stats.queued++;
+}
+
+bool TELEMETRY_QUEUE_peek(telemetryQueueRecord_t *record)
+{
+   if (header.count > 0)
+   {
+      eeprom_read_block(record, &eepromRing[header.head], sizeof(telemetryQueueRecord_t));
+      return true;
+   }
+   if (stats.ramDepth > 0)
+   {
+      *record = ramRing[ramHead];
+      return true;
+   }
+   return false;
+}
+
+void TELEMETRY_QUEUE_pop(void)
+{
+   if (header.count > 0)
+   {
+      header.head = (header.head + 1) % CFG_QUEUE_EEPROM_RECORDS;
+      header.count--;
+      saveHeader();
+      stats.eepromDepth = header.count;
+   }
+   else if (stats.ramDepth > 0)
+   {
+      ramHead = (ramHead + 1) % CFG_QUEUE_RAM_RECORDS;
+      stats.ramDepth--;
+   }
+   else
+   {
+      return;
+   }
+   stats.replayed++;
+}
+
+uint16_t TELEMETRY_QUEUE_depth(void)
+{
+   return stats.ramDepth + header.count;
+}
+
+const telemetryQueueStats_t *TELEMETRY_QUEUE_getStats(void)
+{
+   return &stats;
+}
@@ -0,0 +1,56 @@
+/*
+    \file   telemetry_queue.h
+
+    \brief  Store-and-forward telemetry queue header file.
+
+    Reports that cannot be published (no cloud connection) are queued as
+    compact records in a RAM ring. When the ring is full its oldest record
+    spills to a smaller ring in EEPROM, which survives a reset; when that is
+    full too its oldest record is dropped. To limit EEPROM wear, at most one
+    record spills every CFG_QUEUE_SPILL_INTERVAL seconds: in between, the two
+    oldest RAM records are averaged into one. Records leave the queue oldest
+    first: EEPROM, then RAM.
+
+    The WINC SPI flash is not used: it can only be accessed with the WINC in
+    download mode, i.e. with the Wi-Fi connection down.
+*/
+
+#ifndef TELEMETRY_QUEUE_H_
+#define TELEMETRY_QUEUE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "telemetry.h"
+
+typedef struct
+{
+   uint8_t stream;                            // index in the stream registry
+   uint8_t samples;                           // samples averaged into the values (saturates)
+   time_t  time;                              // avr-libc seconds, 0 if the clock was not set
+   int32_t values[TELEMETRY_MAX_CHANNELS];
+} telemetryQueueRecord_t;
+
+typedef struct
+{
+   uint16_t ramDepth;
+   uint16_t eepromDepth;
+   uint32_t queued;
+   uint32_t spilled;        // moved from RAM to EEPROM
+   uint32_t merged;         // averaged into the next record
+   uint32_t dropped;        // lost: both rings full
+   uint32_t replayed;
+} telemetryQueueStats_t;
+
+// Restore the EEPROM ring left by the previous run
+void TELEMETRY_QUEUE_init(void);
+void TELEMETRY_QUEUE_push(const telemetryQueueRecord_t *record);
+// Copy the oldest record, false if the queue is empty
+bool TELEMETRY_QUEUE_peek(telemetryQueueRecord_t *record);
+// Remove the oldest record, once it has been replayed
+void TELEMETRY_QUEUE_pop(void);
+uint16_t TELEMETRY_QUEUE_depth(void);
+
+const telemetryQueueStats_t *TELEMETRY_QUEUE_getStats(void);
+
+#endif /* TELEMETRY_QUEUE_H_ */
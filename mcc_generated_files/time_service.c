@@ -0,0 +1,240 @@
+/*
+    \file   time_service.c
+
+    \brief  Time service source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+#include "time_service.h"
+#include "mcc.h"
+#include "drivers/timeout.h"
+#include "config/IoT_Sensor_Node_config.h"
+#include "debug_print.h"
+
+// One PIT period (8 cycles of the 1.024kHz RTC clock) is 7.8125ms, in 1/65536 ms
+#define PIT_PERIOD_Q16          512000UL
+#define TIME_TASK_INTERVAL      1000L
+// The WINC reports whole seconds: smaller errors are only quantization
+#define MAX_ERROR_MS            1000L
+// Do not estimate the drift over less than this (ms), the samples are too coarse
+#define MIN_DRIFT_BASELINE_MS   600000UL
+// Reject estimates that are further than this (ppm) from the nominal rate
+#define MAX_DRIFT_PPM           50000L
+
+static ticks    lastTicks;
+static uint32_t rawPeriods;                     // PIT periods since boot
+static uint32_t monoMs;
+static uint16_t monoFraction;                   // 1/65536 ms
+static uint32_t periodQ16 = PIT_PERIOD_Q16;     // corrected duration of a PIT period
+
+static bool     timeSet = false;
+static time_t   syncSeconds;                    // wall clock at monoAtSync
+static uint32_t monoAtSync;
+static uint32_t lastSyncMs;
+
+static time_t   refSeconds;                     // start of the drift measurement
+static uint32_t refPeriods;
+#if defined(RTC_CORREN_bm)
+static int32_t  hwCorrectionPpm = 0;
+#endif
+
+static timeServiceStats_t stats = {.syncIntervalS = CFG_NTP_MIN_INTERVAL};
+
+uint32_t TIME_task(void *param);
+timerStruct_t TIME_taskTimer = {TIME_task};
+
+// Fold the PIT periods elapsed since the last call into the clocks
+static void update(void)
+{
+   ticks now = timeout_getTime();
+   uint16_t periods = (ticks)(now - lastTicks) / SCHEDULER_BASE_PERIOD;
+   uint32_t sum;
+
+   lastTicks += periods * SCHEDULER_BASE_PERIOD;
+   rawPeriods += periods;
+   // TIME_task runs every second, so periods stays far below overflowing sum
+   sum = (uint32_t)periods * periodQ16 + monoFraction;
+   monoMs += sum >> 16;
+   monoFraction = (uint16_t)sum;
+}
+
+static int32_t periodToPpm(uint32_t period)
+{
+   // (period - nominal) * 1e6 / 512000
+   return ((int32_t)period - (int32_t)PIT_PERIOD_Q16) * 125L / 64;
+}
+
+static void applyRate(uint32_t measured)
+{
+#if defined(RTC_CORREN_bm)
+   // Move as much of the error as possible to the RTC hardware correction
+   int32_t ppm = hwCorrectionPpm + periodToPpm(measured);
+   if (labs(ppm) <= 127)
+   {
+      while (RTC.STATUS > 0);
+      RTC.CALIB = (ppm > 0) ? (RTC_SIGN_bm | (uint8_t)ppm) : (uint8_t)(-ppm);
+      RTC.CTRLA |= RTC_CORREN_bm;
+      hwCorrectionPpm = ppm;
+      periodQ16 = PIT_PERIOD_Q16;
+      stats.driftPpm = ppm;
+      return;
+   }
+#endif
+   periodQ16 = measured;
+   stats.driftPpm = periodToPpm(periodQ16);
+}
+
+static void estimateDrift(time_t seconds)
+{
+   uint32_t periods = rawPeriods - refPeriods;
+   uint32_t measuredMs = (uint32_t)(seconds - refSeconds) * 1000UL;
+   uint32_t measured;
+
+   if (periods < MIN_DRIFT_BASELINE_MS / 8)     // PIT periods are just under 8ms
+   {
+      return;
+   }
+   refSeconds = seconds;
+   refPeriods = rawPeriods;
+
+   measured = (uint32_t)(((uint64_t)measuredMs << 16) / periods);
+   if (labs(periodToPpm(measured)) > MAX_DRIFT_PPM)
+   {
+      debug_printError("TIME: drift sample rejected");
+      return;
+   }
+   if (stats.driftKnown)
+   {
+      measured = (3 * (uint64_t)periodQ16 + measured) / 4;
+   }
+   applyRate(measured);
+   stats.driftKnown = true;
+   debug_printInfo("TIME: drift %ldppm", stats.driftPpm);
+}
+
+static void setWallClock(time_t seconds)
+{
+   // On average the sample was taken half way through the reported second
+   syncSeconds = seconds;
+   monoAtSync = monoMs - 500;
+   set_system_time(seconds);
+}
+
+void TIME_init(void)
+{
+   lastTicks = timeout_getTime();
+   timeout_create(&TIME_taskTimer, TIME_TASK_INTERVAL);
+
+   // TCB0 counts CLK_PER/2 up to 0xFFFF and wraps, without interrupts
+   TCB0.CCMP = 0xFFFF;
+   TCB0.CTRLB = TCB_CNTMODE_INT_gc;
+   TCB0.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+}
+
+// Keep the clocks current and the avr-libc system time in step
+uint32_t TIME_task(void *param)
+{
+   update();
+   if (timeSet)
+   {
+      set_system_time(TIME_now(NULL));
+   }
+   return TIME_TASK_INTERVAL;
+}
+
+uint16_t TIME_getTicks(void)
+{
+   // 16-bit register read through TEMP, atomic as long as no ISR reads a TCB0 register
+   return TCB0.CNT;
+}
+
+uint32_t TIME_getMonotonicMs(void)
+{
+   update();
+   return monoMs;
+}
+
+time_t TIME_now(uint16_t *ms)
+{
+   uint32_t elapsed;
+
+   update();
+   if (!timeSet)
+   {
+      if (ms)
+      {
+         *ms = 0;
+      }
+      return 0;
+   }
+   elapsed = monoMs - monoAtSync;
+   if (ms)
+   {
+      *ms = elapsed % 1000;
+   }
+   return syncSeconds + elapsed / 1000;
+}
+
+bool TIME_isSet(void)
+{
+   return timeSet;
+}
+
+void TIME_sync(time_t seconds)
+{
+   int32_t errorMs;
+
+   update();
+   lastSyncMs = monoMs;
+   stats.syncCount++;
+
+   if (!timeSet)
+   {
+      setWallClock(seconds);
+      refSeconds = seconds;
+      refPeriods = rawPeriods;
+      timeSet = true;
+      debug_printInfo("TIME: set");
+      return;
+   }
+
+   errorMs = (int32_t)(seconds - syncSeconds) * 1000L + 500 - (int32_t)(monoMs - monoAtSync);
+   stats.lastErrorMs = errorMs;
+
+   if (labs(errorMs) > MAX_ERROR_MS)
+   {
+      // Either the drift is not known yet or the time source jumped: the drift
+      // measurement keeps its reference, a jump gets rejected there
+      debug_printError("TIME: stepped by %ldms", errorMs);
+      setWallClock(seconds);
+      stats.stepCount++;
+      stats.syncIntervalS = CFG_NTP_MIN_INTERVAL;
+      estimateDrift(seconds);
+      return;
+   }
+
+   estimateDrift(seconds);
+   if (stats.driftKnown && (stats.syncIntervalS < CFG_NTP_MAX_INTERVAL))
+   {
+      // The clock held: ask less often
+      stats.syncIntervalS *= 2;
+      if (stats.syncIntervalS > CFG_NTP_MAX_INTERVAL)
+      {
+         stats.syncIntervalS = CFG_NTP_MAX_INTERVAL;
+      }
+   }
+}
+
+bool TIME_isSyncDue(void)
+{
+   update();
+   return !timeSet || ((monoMs - lastSyncMs) >= stats.syncIntervalS * 1000UL);
+}
+
+const timeServiceStats_t *TIME_getStats(void)
+{
+   return &stats;
+}
@@ -0,0 +1,51 @@
+/*
+    \file   time_service.h
+
+    \brief  Time service header file.
+
+    Keeps a monotonic millisecond clock from the RTC periodic interrupt and a
+    wall clock disciplined against the time samples of the WINC (SNTP).
+    The RTC rate error is estimated between samples and compensated, which
+    lets the WINC queries back off from CFG_NTP_MIN_INTERVAL to
+    CFG_NTP_MAX_INTERVAL once the clock holds its time.
+    The avr-libc system time (time()) is kept in step with the wall clock.
+*/
+
+#ifndef TIME_SERVICE_H_
+#define TIME_SERVICE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "config/clock_config.h"
+
+typedef struct
+{
+   int32_t  driftPpm;         // estimated RTC rate error, > 0 when the RTC runs slow
+   int32_t  lastErrorMs;      // wall clock error found at the last sample
+   uint32_t syncIntervalS;    // current interval between WINC time queries
+   uint16_t syncCount;        // samples received
+   uint16_t stepCount;        // times the wall clock had to be stepped
+   bool     driftKnown;
+} timeServiceStats_t;
+
+void TIME_init(void);
+
+// Milliseconds since boot, never goes backwards (wraps after ~49 days)
+uint32_t TIME_getMonotonicMs(void);
+// Free running 16-bit counter for sub-millisecond intervals, measured by
+// difference: TIME_TICKS_PER_US ticks per microsecond, wraps every ~13ms
+#define TIME_TICKS_PER_US       (F_CPU / 2000000UL)
+uint16_t TIME_getTicks(void);
+// Wall clock in avr-libc seconds (0 until the first sample), ms may be NULL
+time_t TIME_now(uint16_t *ms);
+bool TIME_isSet(void);
+
+// Feed a wall clock sample (avr-libc seconds, 1s resolution)
+void TIME_sync(time_t seconds);
+// True when a new time sample should be requested
+bool TIME_isSyncDue(void);
+
+const timeServiceStats_t *TIME_getStats(void);
+
+#endif /* TIME_SERVICE_H_ */
@@ -0,0 +1,128 @@
+/*
+    \file   cbor_writer.c
+
+    \brief  CBOR (RFC 7049) encoder source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "cbor_writer.h"
+
+#define CBOR_UINT           0x00
+#define CBOR_NEGINT         0x20
+#define CBOR_TEXT           0x60
+#define CBOR_ARRAY          0x80
+#define CBOR_MAP            0xA0
+#define CBOR_TAG            0xC0
+#define CBOR_TAG_DECIMAL    4
+
+static void putByte(cborWriter_t *writer, uint8_t byte)
+{
+   if (writer->length < writer->size)
+   {
+      writer->buffer[writer->length++] = byte;
+   }
+   else
+   {
+      writer->overflow = true;
+   }
+}
+
+// Initial byte and argument, in the shortest form
+static void putHead(cborWriter_t *writer, uint8_t major, uint32_t argument)
+{
+   if (argument < 24)
+   {
+      putByte(writer, major | (uint8_t)argument);
+   }
+   else if (argument <= UINT8_MAX)
+   {
+      putByte(writer, major | 24);
+      putByte(writer, (uint8_t)argument);
+   }
+   else if (argument <= UINT16_MAX)
+   {
+      putByte(writer, major | 25);
+      putByte(writer, (uint8_t)(argument >> 8));
+      putByte(writer, (uint8_t)argument);
+   }
+   else
+   {
+      putByte(writer, major | 26);
+      putByte(writer, (uint8_t)(argument >> 24));
+      putByte(writer, (uint8_t)(argument >> 16));
+      putByte(writer, (uint8_t)(argument >> 8));
+      putByte(writer, (uint8_t)argument);
+   }
+}
+
+void CBOR_init(cborWriter_t *writer, uint8_t *buffer, uint16_t size)
+{
+   writer->buffer = buffer;
+   writer->size = size;
+   writer->length = 0;
+   writer->overflow = false;
+}
+
+void CBOR_putUint(cborWriter_t *writer, uint32_t value)
+{
+   putHead(writer, CBOR_UINT, value);
+}
+
+void CBOR_putInt(cborWriter_t *writer, int32_t value)
+{
+   if (value < 0)
+   {
+      // -1 - n, computed without overflowing on INT32_MIN
+      putHead(writer, CBOR_NEGINT, (uint32_t)(-(value + 1)));
+   }
+   else
+   {
+      putHead(writer, CBOR_UINT, (uint32_t)value);
+   }
+}
+
+void CBOR_putFixed(cborWriter_t *writer, int32_t value, uint8_t decimals)
+{
+   if (decimals == 0)
+   {
+      CBOR_putInt(writer, value);
+      return;
+   }
+   putHead(writer, CBOR_TAG, CBOR_TAG_DECIMAL);
+   putHead(writer, CBOR_ARRAY, 2);
+   CBOR_putInt(writer, -(int32_t)decimals);
+   CBOR_putInt(writer, value);
+}
+
+void CBOR_putText(cborWriter_t *writer, const char *text)
+{
+   uint16_t length = strlen(text);
+
+   putHead(writer, CBOR_TEXT, length);
+   if (writer->length + length <= writer->size)
+   {
+      memcpy(&writer->buffer[writer->length], text, length);
+      writer->length += length;
+   }
+   else
+   {
+      writer->overflow = true;
+   }
+}
+
+void CBOR_openArray(cborWriter_t *writer, uint16_t items)
+{
+   putHead(writer, CBOR_ARRAY, items);
+}
+
+void CBOR_openMap(cborWriter_t *writer, uint16_t pairs)
+{
+   putHead(writer, CBOR_MAP, pairs);
+}
+
+uint16_t CBOR_length(const cborWriter_t *writer)
+{
+   return writer->overflow ? 0 : writer->length;
+}
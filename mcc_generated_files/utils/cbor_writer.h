@@ -0,0 +1,38 @@
+/*
+    \file   cbor_writer.h
+
+    \brief  CBOR (RFC 7049) encoder header file.
+
+    Encodes straight into a caller supplied buffer, without allocation.
+    Containers are written with their item count up front (definite length).
+    Writes past the end of the buffer are dropped and flagged: check
+    CBOR_length() once, at the end.
+*/
+
+#ifndef CBOR_WRITER_H_
+#define CBOR_WRITER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+   uint8_t *buffer;
+   uint16_t size;
+   uint16_t length;
+   bool overflow;
+} cborWriter_t;
+
+void CBOR_init(cborWriter_t *writer, uint8_t *buffer, uint16_t size);
+void CBOR_putUint(cborWriter_t *writer, uint32_t value);
+void CBOR_putInt(cborWriter_t *writer, int32_t value);
+// value / 10^decimals, as a decimal fraction (tag 4)
+void CBOR_putFixed(cborWriter_t *writer, int32_t value, uint8_t decimals);
+void CBOR_putText(cborWriter_t *writer, const char *text);
+void CBOR_openArray(cborWriter_t *writer, uint16_t items);
+// A map of pairs: write each key (CBOR_putText) followed by its value
+void CBOR_openMap(cborWriter_t *writer, uint16_t pairs);
+// Encoded length, 0 if the buffer was too small
+uint16_t CBOR_length(const cborWriter_t *writer);
+
+#endif /* CBOR_WRITER_H_ */
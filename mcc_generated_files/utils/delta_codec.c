@@ -0,0 +1,185 @@
+/*
+    \file   delta_codec.c
+
+    \brief  Delta/varint time series encoder source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "delta_codec.h"
+
+#define LZ_WINDOW       256
+#define LZ_MIN_MATCH    2       // a back reference takes 13 bits, 2 literals 18
+#define LZ_MAX_MATCH    (LZ_MIN_MATCH + 15)
+
+typedef struct
+{
+   uint8_t *buffer;
+   uint16_t size;
+   uint16_t length;
+   uint8_t bits;           // used in the last byte
+   bool overflow;
+} bitWriter_t;
+
+void DELTA_init(deltaWriter_t *writer, uint8_t *buffer, uint16_t size)
+{
+   writer->buffer = buffer;
+   writer->size = size;
+   writer->length = 0;
+   writer->overflow = false;
+}
+
+void DELTA_putByte(deltaWriter_t *writer, uint8_t byte)
+{
+   if (writer->length < writer->size)
+   {
+      writer->buffer[writer->length++] = byte;
+   }
+   else
+   {
+      writer->overflow = true;
+   }
+}
+
+void DELTA_putUvarint(deltaWriter_t *writer, uint32_t value)
+{
+   while (value >= 0x80)
+   {
+      DELTA_putByte(writer, (uint8_t)value | 0x80);
+      value >>= 7;
+   }
+   DELTA_putByte(writer, (uint8_t)value);
+}
+
+void DELTA_putVarint(deltaWriter_t *writer, int32_t value)
+{
+   DELTA_putUvarint(writer, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+void DELTA_putText(deltaWriter_t *writer, const char *text)
+{
+   DELTA_putUvarint(writer, strlen(text));
+   while (*text)
+   {
+      DELTA_putByte(writer, *text++);
+   }
+}
+
+uint16_t DELTA_length(const deltaWriter_t *writer)
+{
+   return writer->overflow ? 0 : writer->length;
+}
+
+void DELTA_beginSeries(deltaSeries_t *series, deltaWriter_t *writer)
+{
+   series->writer = writer;
+   series->previous = 0;
+   series->previousDelta = 0;
+   series->index = 0;
+}
+
+void DELTA_putTime(deltaSeries_t *series, uint32_t time)
+{
+   int32_t delta = (int32_t)time - series->previous;
+
+   if (series->index == 0)
+   {
+      DELTA_putUvarint(series->writer, time);
+   }
+   else if (series->index == 1)
+   {
+      DELTA_putUvarint(series->writer, delta);
+   }
+   else
+   {
+      DELTA_putVarint(series->writer, delta - series->previousDelta);
+   }
+   series->previous = time;
+   series->previousDelta = delta;
+   series->index++;
+}
+
+void DELTA_putValue(deltaSeries_t *series, int32_t value)
+{
+   DELTA_putVarint(series->writer, series->index ? value - series->previous : value);
+   series->previous = value;
+   series->index++;
+}
+
+static void putBits(bitWriter_t *writer, uint16_t value, uint8_t count)
+{
+   while (count--)
+   {
+      if (writer->bits == 0)
+      {
+         if (writer->length == writer->size)
+         {
+            writer->overflow = true;
+            return;
+         }
+         writer->buffer[writer->length++] = 0;
+      }
+      if (value & (1U << count))
+      {
+         writer->buffer[writer->length - 1] |= 0x80 >> writer->bits;
+      }
+      writer->bits = (writer->bits + 1) & 7;
+   }
+}
+
+uint16_t DELTA_compress(const uint8_t *input, uint16_t length, uint8_t *output, uint16_t size)
+{
+   bitWriter_t writer = {output, (size < length) ? size : length - 1, 0, 0, false};
+   uint16_t position = 0;
+
+   if (length < 2)
+   {
+      return 0;
+   }
+   while ((position < length) && !writer.overflow)
+   {
+      uint16_t bestLength = 0;
+      uint16_t bestOffset = 0;
+      uint16_t offset;
+      uint16_t maxMatch = length - position;
+
+      if (maxMatch > LZ_MAX_MATCH)
+      {
+         maxMatch = LZ_MAX_MATCH;
+      }
+      for (offset = 1; (offset <= LZ_WINDOW) && (offset <= position); offset++)
+      {
+         const uint8_t *match = &input[position - offset];
+         uint16_t n = 0;
+
+         // May run into the bytes being matched: repeats a short pattern
+         while ((n < maxMatch) && (match[n] == input[position + n]))
+         {
+            n++;
+         }
+         if (n > bestLength)
+         {
+            bestLength = n;
+            bestOffset = offset;
+            if (n == maxMatch)
+            {
+               break;
+            }
+         }
+      }
+      if (bestLength >= LZ_MIN_MATCH)
+      {
+         putBits(&writer, 0, 1);
+         putBits(&writer, bestOffset - 1, 8);
+         putBits(&writer, bestLength - LZ_MIN_MATCH, 4);
+         position += bestLength;
+      }
+      else
+      {
+         putBits(&writer, 0x100 | input[position], 9);
+         position++;
+      }
+   }
+   return writer.overflow ? 0 : writer.length;
+}
@@ -0,0 +1,63 @@
+/*
+    \file   delta_codec.h
+
+    \brief  Delta/varint time series encoder header file.
+
+    Integers are written as LEB128 varints (7 bits per byte, low group first,
+    top bit set on all but the last byte); signed ones are zig-zag mapped
+    first (0, -1, 1, -2... -> 0, 1, 2, 3...), so small magnitudes take one byte.
+
+    A series of timestamps is written as the first one, the first delta, then
+    the change of the delta (delta-of-delta): zero for a steady sample interval.
+    A series of values is written as the first one, then the deltas.
+
+    DELTA_compress() is an optional LZSS pass in the spirit of heatshrink, with
+    a fixed 256 byte window over the input and no RAM besides the output:
+        '1' + 8 bit literal
+        '0' + 8 bit offset - 1 + 4 bit length - 2 (2 to 17 bytes back in the input)
+    MSB first, the last byte padded with 0 bits (fewer than 9 bits left: end).
+    It is not bit compatible with heatshrink.
+*/
+
+#ifndef DELTA_CODEC_H_
+#define DELTA_CODEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+   uint8_t *buffer;
+   uint16_t size;
+   uint16_t length;
+   bool overflow;
+} deltaWriter_t;
+
+typedef struct
+{
+   deltaWriter_t *writer;
+   int32_t previous;
+   int32_t previousDelta;
+   uint16_t index;
+} deltaSeries_t;
+
+void DELTA_init(deltaWriter_t *writer, uint8_t *buffer, uint16_t size);
+void DELTA_putByte(deltaWriter_t *writer, uint8_t byte);
+void DELTA_putUvarint(deltaWriter_t *writer, uint32_t value);
+void DELTA_putVarint(deltaWriter_t *writer, int32_t value);
+// Length, then the characters
+void DELTA_putText(deltaWriter_t *writer, const char *text);
+// Encoded length, 0 if the buffer was too small
+uint16_t DELTA_length(const deltaWriter_t *writer);
+
+void DELTA_beginSeries(deltaSeries_t *series, deltaWriter_t *writer);
+// Non decreasing timestamps, delta-of-delta coded
+void DELTA_putTime(deltaSeries_t *series, uint32_t time);
+// Values, delta coded
+void DELTA_putValue(deltaSeries_t *series, int32_t value);
+
+// LZSS pass over input, returns the compressed length, 0 if it does not fit
+// in size or would not be shorter
+uint16_t DELTA_compress(const uint8_t *input, uint16_t length, uint8_t *output, uint16_t size);
+
+#endif /* DELTA_CODEC_H_ */
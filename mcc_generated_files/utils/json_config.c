@@ -0,0 +1,495 @@
+/*
+    \file   json_config.c
+
+    \brief  Streaming JSON config parser source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "json_config.h"
+
+// Largest value that can take one more digit without overflowing an int32_t
+#define FIXED_MAX   ((INT32_MAX - 9) / 10)
+
+typedef enum
+{
+   EXPECT_VALUE = 0,    // start, after ':' or ',' in an array
+   EXPECT_VALUE_OR_END, // after '['
+   EXPECT_KEY,          // after ',' in an object
+   EXPECT_KEY_OR_END,   // after '{'
+   IN_KEY,
+   EXPECT_COLON,
+   IN_STRING,
+   IN_SCALAR,           // number, true, false or null
+   EXPECT_NEXT,         // after a value: ',' or the end of the container
+   DONE,
+   FAILED
+} parserState_t;
+
+static bool isSpace(char c)
+{
+   return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+static bool inArray(const jsonConfigParser_t *parser)
+{
+   return (parser->depth > 0) && (parser->arrays & (1 << (parser->depth - 1)));
+}
+
+// In an array, or in an object at any depth below one
+static bool underArray(const jsonConfigParser_t *parser)
+{
+   return (parser->arrays & ((1 << parser->depth) - 1)) != 0;
+}
+
+static bool isDigit(char c)
+{
+   return (c >= '0') && (c <= '9');
+}
+
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool isNumber(const char *text)
+{
+   if (*text == '-')
+   {
+      text++;
+   }
+   if (!isDigit(*text) || ((*text == '0') && isDigit(text[1])))
+   {
+      return false;
+   }
+   while (isDigit(*text))
+   {
+      text++;
+   }
+   if (*text == '.')
+   {
+      if (!isDigit(*++text))
+      {
+         return false;
+      }
+      while (isDigit(*text))
+      {
+         text++;
+      }
+   }
+   if ((*text == 'e') || (*text == 'E'))
+   {
+      text++;
+      if ((*text == '+') || (*text == '-'))
+      {
+         text++;
+      }
+      if (!isDigit(*text))
+      {
+         return false;
+      }
+      while (isDigit(*text))
+      {
+         text++;
+      }
+   }
+   return (*text == '\0');
+}
+
+static void appendValue(jsonConfigParser_t *parser, char c)
+{
+   if (parser->valueLength < JSON_CONFIG_VALUE_MAX - 1)
+   {
+      parser->value[parser->valueLength++] = c;
+   }
+   else
+   {
+      parser->valueOverflow = true;
+   }
+}
+
+// Key characters extend the path, unless an enclosing key already did not fit
+static void appendPath(jsonConfigParser_t *parser, char c)
+{
+   if (parser->overflowDepth != 0)
+   {
+      return;
+   }
+   if (parser->pathLength < JSON_CONFIG_PATH_MAX - 1)
+   {
+      parser->path[parser->pathLength++] = c;
+   }
+   else
+   {
+      parser->overflowDepth = parser->depth;
+   }
+}
+
+static char unescape(char c)
+{
+   switch (c)
+   {
+      case 'n': return '\n';
+      case 'r': return '\r';
+      case 't': return '\t';
+      case 'b': return '\b';
+      case 'f': return '\f';
+      case 'u': return '?';      // \uXXXX: the digits follow as plain characters
+      default:  return c;
+   }
+}
+
+// Parse a JSON number as a fixed point value, extra decimals are truncated
+bool JSON_CONFIG_parseFixed(const char *text, uint8_t decimals, int32_t *result)
+{
+   bool negative = (*text == '-');
+   bool digits = false;
+   int32_t value = 0;
+
+   if (negative)
+   {
+      text++;
+   }
+   while ((*text >= '0') && (*text <= '9'))
+   {
+      if (value > FIXED_MAX)
+      {
+         return false;
+      }
+      value = value * 10 + (*text++ - '0');
+      digits = true;
+   }
+   if (*text == '.')
+   {
+      text++;
+      while ((*text >= '0') && (*text <= '9'))
+      {
+         if (decimals > 0)
+         {
+            if (value > FIXED_MAX)
+            {
+               return false;
+            }
+            value = value * 10 + (*text - '0');
+            decimals--;
+         }
+         text++;
+      }
+   }
+   if (!digits || (*text != '\0'))
+   {
+      return false;    // exponents are not supported
+   }
+   while (decimals--)
+   {
+      if (value > FIXED_MAX)
+      {
+         return false;
+      }
+      value *= 10;
+   }
+   *result = negative ? -value : value;
+   return true;
+}
+
+static void applyValue(jsonConfigParser_t *parser, bool isString)
+{
+   const jsonConfigBinding_t *binding = parser->bindings;
+   uint8_t i;
+   int32_t number;
+
+   if (underArray(parser) || (parser->overflowDepth != 0) || parser->valueOverflow)
+   {
+      return;
+   }
+   parser->value[parser->valueLength] = '\0';
+   parser->path[parser->pathLength] = '\0';
+   for (i = 0; i < parser->count; i++, binding++)
+   {
+      if (strcmp(binding->path, parser->path) != 0)
+      {
+         continue;
+      }
+      switch (binding->type)
+      {
+         case JSON_CONFIG_BOOL:
+            if (isString)
+            {
+               return;
+            }
+            if ((strcmp(parser->value, "true") == 0) || (strcmp(parser->value, "false") == 0))
+            {
+               binding->set.setBool(parser->value[0] == 't');
+            }
+            else if (JSON_CONFIG_parseFixed(parser->value, 0, &number))
+            {
+               binding->set.setBool(number != 0);
+            }
+            else
+            {
+               return;
+            }
+            break;
+         case JSON_CONFIG_INT:
+            if (isString || !JSON_CONFIG_parseFixed(parser->value, binding->decimals, &number))
+            {
+               return;
+            }
+            binding->set.setInt(number);
+            break;
+         case JSON_CONFIG_STRING:
+            if (!isString)
+            {
+               return;
+            }
+            binding->set.setString(parser->value);
+            break;
+         default:
+            return;
+      }
+      parser->applied++;
+      return;
+   }
+}
+
+static void openContainer(jsonConfigParser_t *parser, bool array)
+{
+   if (parser->depth == JSON_CONFIG_DEPTH_MAX)
+   {
+      parser->state = FAILED;
+      return;
+   }
+   parser->pathBase[parser->depth] = parser->pathLength;
+   if (array)
+   {
+      parser->arrays |= (1 << parser->depth);
+   }
+   else
+   {
+      parser->arrays &= ~(1 << parser->depth);
+   }
+   parser->depth++;
+   parser->state = array ? EXPECT_VALUE_OR_END : EXPECT_KEY_OR_END;
+}
+
+static void closeContainer(jsonConfigParser_t *parser, bool array)
+{
+   if ((parser->depth == 0) || (inArray(parser) != array))
+   {
+      parser->state = FAILED;
+      return;
+   }
+   parser->depth--;
+   if (parser->overflowDepth > parser->depth)
+   {
+      parser->overflowDepth = 0;
+   }
+   parser->pathLength = parser->pathBase[parser->depth];
+   parser->state = (parser->depth == 0) ? DONE : EXPECT_NEXT;
+}
+
+// A value is complete: the next token is ',' or the end of the container
+static void valueDone(jsonConfigParser_t *parser)
+{
+   parser->state = (parser->depth == 0) ? DONE : EXPECT_NEXT;
+}
+
+// A number, true, false or null ended
+static void scalarDone(jsonConfigParser_t *parser)
+{
+   const char *value = parser->value;
+   bool valid;
+
+   parser->value[parser->valueLength] = '\0';
+   if (parser->valueOverflow)
+   {
+      // Too long for any literal: only a number, checked as far as it was kept
+      valid = (strspn(value, "-+.eE0123456789") == parser->valueLength);
+   }
+   else if ((*value == 't') || (*value == 'f') || (*value == 'n'))
+   {
+      valid = (strcmp(value, "true") == 0) || (strcmp(value, "false") == 0) || (strcmp(value, "null") == 0);
+   }
+   else
+   {
+      valid = isNumber(value);
+   }
+   if (!valid)
+   {
+      parser->state = FAILED;
+      return;
+   }
+   applyValue(parser, false);
+   valueDone(parser);
+}
+
+static void startKey(jsonConfigParser_t *parser)
+{
+   uint8_t base = parser->pathBase[parser->depth - 1];
+
+   if (parser->overflowDepth >= parser->depth)
+   {
+      parser->overflowDepth = 0;    // a sibling of the key that did not fit
+   }
+   parser->pathLength = base;
+   if (base > 0)
+   {
+      appendPath(parser, '.');
+   }
+   parser->state = IN_KEY;
+}
+
+static void parseChar(jsonConfigParser_t *parser, char c)
+{
+   switch (parser->state)
+   {
+      case IN_KEY:
+      case IN_STRING:
+         if (parser->escape)
+         {
+            parser->escape = false;
+            c = unescape(c);
+         }
+         else if (c == '\\')
+         {
+            parser->escape = true;
+            return;
+         }
+         else if (c == '"')
+         {
+            if (parser->state == IN_KEY)
+            {
+               parser->state = EXPECT_COLON;
+            }
+            else
+            {
+               applyValue(parser, true);
+               valueDone(parser);
+            }
+            return;
+         }
+         if (parser->state == IN_KEY)
+         {
+            appendPath(parser, c);
+         }
+         else
+         {
+            appendValue(parser, c);
+         }
+         return;
+      case IN_SCALAR:
+         if ((c != ',') && (c != '}') && (c != ']') && !isSpace(c))
+         {
+            appendValue(parser, c);
+            return;
+         }
+         scalarDone(parser);
+         if (parser->state == FAILED)
+         {
+            return;
+         }
+         break;     // the delimiter is parsed below
+      default:
+         break;
+   }
+
+   if (isSpace(c))
+   {
+      return;
+   }
+   switch (parser->state)
+   {
+      case EXPECT_VALUE_OR_END:
+         if (c == ']')
+         {
+            closeContainer(parser, true);    // empty array
+            break;
+         }
+         // fall through
+      case EXPECT_VALUE:
+         parser->valueLength = 0;
+         parser->valueOverflow = false;
+         if (c == '{')
+         {
+            openContainer(parser, false);
+         }
+         else if (c == '[')
+         {
+            openContainer(parser, true);
+         }
+         else if (c == '"')
+         {
+            parser->state = IN_STRING;
+         }
+         else if ((c == '-') || ((c >= '0') && (c <= '9')) || (c == 't') || (c == 'f') || (c == 'n'))
+         {
+            appendValue(parser, c);
+            parser->state = IN_SCALAR;
+         }
+         else
+         {
+            parser->state = FAILED;
+         }
+         break;
+      case EXPECT_KEY_OR_END:
+         if (c == '}')
+         {
+            closeContainer(parser, false);   // empty object
+            break;
+         }
+         // fall through
+      case EXPECT_KEY:
+         if (c == '"')
+         {
+            startKey(parser);
+         }
+         else
+         {
+            parser->state = FAILED;
+         }
+         break;
+      case EXPECT_COLON:
+         parser->state = (c == ':') ? EXPECT_VALUE : FAILED;
+         break;
+      case EXPECT_NEXT:
+         if (c == ',')
+         {
+            parser->state = inArray(parser) ? EXPECT_VALUE : EXPECT_KEY;
+         }
+         else if ((c == '}') || (c == ']'))
+         {
+            closeContainer(parser, c == ']');
+         }
+         else
+         {
+            parser->state = FAILED;
+         }
+         break;
+      default:
+         parser->state = FAILED;     // data after the document
+         break;
+   }
+}
+
+void JSON_CONFIG_begin(jsonConfigParser_t *parser, const jsonConfigBinding_t *bindings, uint8_t count)
+{
+   memset(parser, 0, sizeof(jsonConfigParser_t));
+   parser->bindings = bindings;
+   parser->count = count;
+   parser->state = EXPECT_VALUE;
+}
+
+void JSON_CONFIG_feed(jsonConfigParser_t *parser, const char *data, uint16_t length)
+{
+   while (length-- && (parser->state != FAILED))
+   {
+      parseChar(parser, *data++);
+   }
+}
+
+int8_t JSON_CONFIG_end(jsonConfigParser_t *parser)
+{
+   // A bare top level number ends with the document
+   if (parser->state == IN_SCALAR)
+   {
+      scalarDone(parser);
+   }
+   return (parser->state == DONE) ? parser->applied : -1;
+}
@@ -0,0 +1,74 @@
+/*
+    \file   json_config.h
+
+    \brief  Streaming JSON config parser header file.
+
+    Tokenizes a JSON document one fragment at a time, without keeping it in
+    memory, and hands each value whose path (object keys joined by '.', e.g.
+    "Temp.deadband") is listed in the bindings table to the bound setter.
+    Values inside arrays (at any depth) and values without a binding are
+    skipped.
+
+    Settings are applied as they are parsed: a document that turns out to be
+    malformed may already have applied the values before the error.
+*/
+
+#ifndef JSON_CONFIG_H_
+#define JSON_CONFIG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JSON_CONFIG_PATH_MAX    24      // longest path, including the terminator
+#define JSON_CONFIG_VALUE_MAX   24      // longest value, including the terminator
+#define JSON_CONFIG_DEPTH_MAX   8       // nested objects and arrays
+
+typedef enum
+{
+   JSON_CONFIG_BOOL = 0,   // true, false or a number (0 = false)
+   JSON_CONFIG_INT,        // number, as a fixed point value with decimals digits
+   JSON_CONFIG_STRING
+} jsonConfigType_t;
+
+typedef struct
+{
+   const char *path;
+   jsonConfigType_t type;
+   uint8_t decimals;       // JSON_CONFIG_INT: 1.5 with 2 decimals is set as 150
+   union
+   {
+      void (*setBool)(bool value);
+      void (*setInt)(int32_t value);
+      void (*setString)(const char *value);
+   } set;
+} jsonConfigBinding_t;
+
+typedef struct
+{
+   const jsonConfigBinding_t *bindings;
+   uint8_t count;
+   uint8_t state;
+   uint8_t depth;
+   uint8_t arrays;                            // open arrays
+   uint8_t pathBase[JSON_CONFIG_DEPTH_MAX];   // path length of the enclosing object
+   uint8_t pathLength;
+   uint8_t overflowDepth;                     // depth of a key that did not fit, 0 = none
+   uint8_t valueLength;
+   bool valueOverflow;
+   bool escape;
+   uint8_t applied;
+   char path[JSON_CONFIG_PATH_MAX];
+   char value[JSON_CONFIG_VALUE_MAX];
+} jsonConfigParser_t;
+
+void JSON_CONFIG_begin(jsonConfigParser_t *parser, const jsonConfigBinding_t *bindings, uint8_t count);
+// Feed the next fragment of the document
+void JSON_CONFIG_feed(jsonConfigParser_t *parser, const char *data, uint16_t length);
+// Returns the number of settings applied, -1 if the document is malformed or incomplete
+int8_t JSON_CONFIG_end(jsonConfigParser_t *parser);
+
+// Parse a JSON number (the whole text) as a fixed point value with decimals
+// digits, e.g. for values carried in strings. Extra decimals are truncated.
+bool JSON_CONFIG_parseFixed(const char *text, uint8_t decimals, int32_t *result);
+
+#endif /* JSON_CONFIG_H_ */
@@ -0,0 +1,137 @@
+/*
+    \file   text_writer.c
+
+    \brief  Text/JSON writer source file.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "text_writer.h"
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+void TEXT_init(textWriter_t *writer, char *buffer, uint16_t size)
+{
+   writer->buffer = buffer;
+   writer->size = size;
+   writer->length = 0;
+   writer->overflow = (size == 0);
+   if (size > 0)
+   {
+      buffer[0] = '\0';
+   }
+}
+
+void TEXT_putChar(textWriter_t *writer, char c)
+{
+   if (writer->length + 1 < writer->size)
+   {
+      writer->buffer[writer->length++] = c;
+      writer->buffer[writer->length] = '\0';
+   }
+   else
+   {
+      writer->overflow = true;
+   }
+}
+
+void TEXT_putString(textWriter_t *writer, const char *text)
+{
+   while (*text)
+   {
+      TEXT_putChar(writer, *text++);
+   }
+}
+
+void TEXT_putJsonString(textWriter_t *writer, const char *text)
+{
+   TEXT_putChar(writer, '"');
+   while (*text)
+   {
+      uint8_t c = (uint8_t)*text++;
+
+      if ((c == '"') || (c == '\\'))
+      {
+         TEXT_putChar(writer, '\\');
+         TEXT_putChar(writer, c);
+      }
+      else if (c < ' ')
+      {
+         TEXT_putString(writer, "\\u00");
+         TEXT_putHex(writer, &c, 1);
+      }
+      else
+      {
+         TEXT_putChar(writer, c);
+      }
+   }
+   TEXT_putChar(writer, '"');
+}
+
+// Write value with at least minDigits digits (zero padded)
+static void putDigits(textWriter_t *writer, uint32_t value, uint8_t minDigits)
+{
+   char digits[10];
+   uint8_t count = 0;
+
+   do
+   {
+      digits[count++] = '0' + (value % 10);
+      value /= 10;
+   } while ((value > 0) || (count < minDigits));
+   while (count > 0)
+   {
+      TEXT_putChar(writer, digits[--count]);
+   }
+}
+
+void TEXT_putUint(textWriter_t *writer, uint32_t value)
+{
+   putDigits(writer, value, 1);
+}
+
+void TEXT_putInt(textWriter_t *writer, int32_t value)
+{
+   TEXT_putFixed(writer, value, 0);
+}
+
+void TEXT_putFixed(textWriter_t *writer, int32_t value, uint8_t decimals)
+{
+   uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+   uint32_t scale = 1;
+   uint8_t i;
+
+   if (value < 0)
+   {
+      TEXT_putChar(writer, '-');
+   }
+   if (decimals > 9)
+   {
+      decimals = 9;
+   }
+   for (i = 0; i < decimals; i++)
+   {
+      scale *= 10;
+   }
+   putDigits(writer, magnitude / scale, 1);
+   if (decimals > 0)
+   {
+      TEXT_putChar(writer, '.');
+      putDigits(writer, magnitude % scale, decimals);
+   }
+}
+
+void TEXT_putHex(textWriter_t *writer, const uint8_t *data, uint16_t length)
+{
+   while (length--)
+   {
+      TEXT_putChar(writer, hexDigits[*data >> 4]);
+      TEXT_putChar(writer, hexDigits[*data & 0x0F]);
+      data++;
+   }
+}
+
+uint16_t TEXT_length(const textWriter_t *writer)
+{
+   return writer->overflow ? 0 : writer->length;
+}
@@ -0,0 +1,41 @@
+/*
+    \file   text_writer.h
+
+    \brief  Text/JSON writer header file.
+
+    Appends text, integers, fixed point values and escaped JSON strings to a
+    caller supplied buffer, without printf. The buffer is kept NUL terminated;
+    on overflow the text is truncated and TEXT_length() returns 0, so a single
+    check at the end is enough.
+*/
+
+#ifndef TEXT_WRITER_H_
+#define TEXT_WRITER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+   char *buffer;
+   uint16_t size;       // including the terminator
+   uint16_t length;
+   bool overflow;
+} textWriter_t;
+
+void TEXT_init(textWriter_t *writer, char *buffer, uint16_t size);
+void TEXT_putChar(textWriter_t *writer, char c);
+// Copy text as is
+void TEXT_putString(textWriter_t *writer, const char *text);
+// Quoted JSON string, with '"', '\' and control characters escaped
+void TEXT_putJsonString(textWriter_t *writer, const char *text);
+void TEXT_putUint(textWriter_t *writer, uint32_t value);
+void TEXT_putInt(textWriter_t *writer, int32_t value);
+// value / 10^decimals, e.g. -5 with 2 decimals is "-0.05"
+void TEXT_putFixed(textWriter_t *writer, int32_t value, uint8_t decimals);
+// Upper case hex digits, two per byte
+void TEXT_putHex(textWriter_t *writer, const uint8_t *data, uint16_t length);
+// Text length, 0 if the buffer was too small
+uint16_t TEXT_length(const textWriter_t *writer);
+
+#endif /* TEXT_WRITER_H_ */
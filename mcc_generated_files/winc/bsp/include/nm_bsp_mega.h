@@ -42,6 +42,7 @@
 #ifndef _NM_BSP_MEGA_H_
 #define _NM_BSP_MEGA_H_
 
+#include <stdint.h>
 #include "../../../config/conf_winc.h"
 
 #define NM_EDGE_INTERRUPT		(1)
@@ -49,4 +50,21 @@
 #define NM_DEBUG				CONF_WINC_DEBUG
 #define NM_BSP_debug_print			CONF_WINC_debug_print
 
+#define NM_BSP_EVENT_NONE		(0)
+#define NM_BSP_EVENT_IRQ		(1)		/* from the pin interrupt */
+#define NM_BSP_EVENT_LINE		(2)		/* the line found low, the edge was missed */
+
+uint8_t nm_bsp_take_event(uint16_t *pu16Ticks, uint16_t *pu16Ms);
+
+typedef struct {
+	uint32_t u32AwakeMs;		/* powered up and not put to sleep by the host, current period included */
+	uint32_t u32WakeUs;			/* chip_wake() time, all wakes */
+	uint32_t u32WakeUsMax;
+	uint16_t u16Wakes;			/* out of power save sleep, by the host */
+} tstrNmBspAwake;
+
+void nm_bsp_wake_start(void);
+void nm_bsp_chip_awake(uint8_t u8Awake);
+void nm_bsp_get_awake(tstrNmBspAwake *pstrAwake);
+
 #endif /* _NM_BSP_MEGA_H_ */
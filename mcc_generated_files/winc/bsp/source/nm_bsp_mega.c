@@ -46,19 +46,45 @@
 #include <util/delay.h>
 #include "../../../config/conf_winc.h"
 #include "../../../include/port.h"
+#include "../../../drivers/timeout.h"
+#include "../../../time_service.h"
+#include "../include/nm_bsp_mega.h"
 
 static tpfNmBspIsr gpfIsr;
 
+/* First interrupt not taken by nm_bsp_take_event() yet, and when it came */
+static volatile uint8 gu8Event;
+static volatile uint16 gu16EventTicks;
+static volatile uint16 gu16EventMs;
+
+/* Time the WINC was awake, see nm_bsp_get_awake() */
+static uint8 gu8Awake;
+static uint8 gu8Waking;
+static uint32 gu32AwakeSinceMs;
+static uint16 gu16WakeTicks;
+static uint16 gu16WakeMs;
+static tstrNmBspAwake gstrAwake;
+
+static void event(uint8 u8Source)
+{
+	gpfIsr();
+	if (!gu8Event) {
+		gu8Event = u8Source;
+		gu16EventTicks = TIME_getTicks();
+		gu16EventMs = timeout_getTime();
+	}
+}
+
 ISR(CONF_WIFI_M2M_INT_vect)
 {
 	if (!(CONF_WIFI_M2M_INT_PIN_GetValue()) && gpfIsr) {
-		gpfIsr();
+		event(NM_BSP_EVENT_IRQ);
 	}
 	
 	/* Insert your PORTF interrupt handling code here */
 
  	/* Clear interrupt flags */
-	VPORTF_INTFLAGS = (1 << 2);
+	CONF_WIFI_M2M_INT_PIN_ClearInterruptFlag();
 }
 
 
@@ -119,6 +145,7 @@ void nm_bsp_reset(void)
 	nm_bsp_sleep(20);
 	CONF_WIFI_M2M_RESET_PIN_SetHigh();
    nm_bsp_sleep(100);
+	nm_bsp_chip_awake(1);
 }
 
 /*
@@ -143,6 +170,7 @@ void nm_bsp_sleep(uint32 u32TimeMsec)
 void nm_bsp_register_isr(tpfNmBspIsr pfIsr)
 {
 	gpfIsr = pfIsr;
+	gu8Event = NM_BSP_EVENT_NONE;
 	
 	CONF_WIFI_M2M_INT_PIN_SetDigitalInput();
 	CONF_WIFI_M2M_INT_PIN_SetPullUp();
@@ -152,6 +180,88 @@ void nm_bsp_register_isr(tpfNmBspIsr pfIsr)
 	CONF_WIFI_M2M_INT_PIN_EnableInterruptForFallingEdge();
 }
 
+/*
+ *	@fn		nm_bsp_take_event
+ *	@brief	Whether the WINC interrupted since the last call, to run m2m_wifi_handle_events().
+ *			A falling edge is missed while the HIF has the pin interrupt disabled: the
+ *			WINC then holds the line low, that is taken for an interrupt too.
+ *	@param[OUT]	pu16Ticks, pu16Ms
+ *				TIME_getTicks() and timeout_getTime() at the interrupt
+ *	@return	NM_BSP_EVENT_NONE, NM_BSP_EVENT_IRQ or NM_BSP_EVENT_LINE
+ */
+uint8 nm_bsp_take_event(uint16 *pu16Ticks, uint16 *pu16Ms)
+{
+	uint8 u8Event;
+
+	cpu_irq_disable();
+	/* Not if the edge is flagged: the ISR is about to count it */
+	if (!gu8Event && gpfIsr && !(CONF_WIFI_M2M_INT_PIN_GetValue())
+			&& !(CONF_WIFI_M2M_INT_PIN_GetInterruptFlag()) && CONF_WIFI_M2M_INT_PIN_IsInterruptEnabled()) {
+		event(NM_BSP_EVENT_LINE);
+	}
+	u8Event = gu8Event;
+	*pu16Ticks = gu16EventTicks;
+	*pu16Ms = gu16EventMs;
+	gu8Event = NM_BSP_EVENT_NONE;
+	cpu_irq_enable();
+	return u8Event;
+}
+
+/*
+ *	@fn		nm_bsp_wake_start
+ *	@brief	The host starts waking the WINC up (chip_wake()), the wake up is timed
+ *			until nm_bsp_chip_awake(1)
+ */
+void nm_bsp_wake_start(void)
+{
+	gu16WakeTicks = TIME_getTicks();
+	gu16WakeMs = timeout_getTime();
+	gu8Waking = 1;
+}
+
+/*
+ *	@fn		nm_bsp_chip_awake
+ *	@brief	The WINC was powered up or woken up by the host (1), put to sleep or
+ *			powered down (0)
+ */
+void nm_bsp_chip_awake(uint8 u8Awake)
+{
+	uint32 u32Now = TIME_getMonotonicMs();
+
+	if (u8Awake && gu8Waking) {
+		/* To the microsecond within a scheduler tick (the ticks wrap every ~13ms) */
+		uint16 u16Elapsed = timeout_getTime() - gu16WakeMs;
+		uint32 u32Us = u16Elapsed ? timeout_toUs(u16Elapsed)
+				: (uint16)(TIME_getTicks() - gu16WakeTicks) / TIME_TICKS_PER_US;
+
+		gu8Waking = 0;
+		gstrAwake.u16Wakes++;
+		gstrAwake.u32WakeUs += u32Us;
+		if (u32Us > gstrAwake.u32WakeUsMax) {
+			gstrAwake.u32WakeUsMax = u32Us;
+		}
+	}
+	if (u8Awake && !gu8Awake) {
+		gu32AwakeSinceMs = u32Now;
+	} else if (!u8Awake && gu8Awake) {
+		gstrAwake.u32AwakeMs += u32Now - gu32AwakeSinceMs;
+	}
+	gu8Awake = u8Awake;
+}
+
+/*
+ *	@fn		nm_bsp_get_awake
+ *	@brief	Time the WINC was awake since the first power up: an average current proxy.
+ *			The WINC waking itself up for beacons in power save is not seen.
+ */
+void nm_bsp_get_awake(tstrNmBspAwake *pstrAwake)
+{
+	*pstrAwake = gstrAwake;
+	if (gu8Awake) {
+		pstrAwake->u32AwakeMs += TIME_getMonotonicMs() - gu32AwakeSinceMs;
+	}
+}
+
 /*
  *	@fn		nm_bsp_interrupt_ctrl
  *	@brief	Enable/Disable interrupts
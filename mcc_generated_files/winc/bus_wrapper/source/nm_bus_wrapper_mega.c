@@ -50,6 +50,7 @@
 #include "../../../include/pin_manager.h"
 #include <util/delay.h>
 #include "../../../include/spi0.h"
+#include "../../../config/IoT_Sensor_Node_config.h"
 
 #define NM_BUS_MAX_TRX_SZ	256
 
@@ -82,6 +83,59 @@ static sint8 nm_i2c_write_special(uint8 *wb1, uint16 sz1, uint8 *wb2, uint16 sz2
 #endif
 
 #ifdef CONF_WINC_USE_SPI
+#if CFG_WINC_SPI_BUFFERED
+/*
+*	SPI0 runs in buffered mode (BUFEN, set in nm_bus_init): the next byte waits
+*	in the transmit buffer while the current one shifts out, so the bytes go
+*	back to back at SCK as long as the loop keeps up. At most two bytes are in
+*	flight, each received byte is read before the next but one is written: the
+*	two level receive buffer never overflows, even for writes.
+*	Always inlined, with NULL folded away: a read-only, a write-only and a
+*	full-duplex loop.
+*/
+static inline __attribute__((always_inline)) void spi_transfer(uint8 *pu8Mosi, uint8 *pu8Miso, uint16 u16Sz)
+{
+	uint16 u16Tx = u16Sz - 1;
+	uint8 u8Rx;
+
+	SPI0.DATA = pu8Mosi ? *pu8Mosi++ : 0;
+	if (u16Tx) {
+		while (!(SPI0.INTFLAGS & SPI_DREIF_bm))
+			;
+		SPI0.DATA = pu8Mosi ? *pu8Mosi++ : 0;
+		u16Tx--;
+	}
+	while (u16Sz--) {
+		while (!(SPI0.INTFLAGS & SPI_RXCIF_bm))
+			;
+		u8Rx = SPI0.DATA;
+		if (u16Tx) {
+			/* The transmit buffer emptied into the shift register as this byte completed */
+			SPI0.DATA = pu8Mosi ? *pu8Mosi++ : 0;
+			u16Tx--;
+		}
+		if (pu8Miso)
+			*pu8Miso++ = u8Rx;
+	}
+}
+
+static sint8 spi_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
+{
+	if (!u16Sz)
+		return M2M_SUCCESS;
+
+	CONF_WIFI_M2M_SPI_CS_PIN_set_level(false);
+	if (!pu8Mosi)
+		spi_transfer(NULL, pu8Miso, u16Sz);
+	else if (!pu8Miso)
+		spi_transfer(pu8Mosi, NULL, u16Sz);
+	else
+		spi_transfer(pu8Mosi, pu8Miso, u16Sz);
+	CONF_WIFI_M2M_SPI_CS_PIN_set_level(true);
+
+	return M2M_SUCCESS;
+}
+#else
 static sint8 spi_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
 {
 	//struct spi_device spi_device_conf;
@@ -123,6 +177,7 @@ static sint8 spi_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
 
 	return M2M_SUCCESS;
 }
+#endif /* CFG_WINC_SPI_BUFFERED */
 #endif
 
 /*
@@ -159,6 +214,10 @@ sint8 volatile nm_bus_init(void *pvinit)
 	/* Configure the SPI master. */
 	//spi_master_init(CONF_WIFI_M2M_SPI_MODULE);
 	SPI0_Initialize();
+#if CFG_WINC_SPI_BUFFERED
+	/* For spi_rw(). SCK stays at CLK_PER/2 (PRESC DIV4 with CLK2X), the fastest the SPI master runs. */
+	SPI0.CTRLB |= SPI_BUFEN_bm;
+#endif
 	
 	//spi_master_setup_device(CONF_WIFI_M2M_SPI_MODULE, &spi_device_conf, SPI_MODE_0, CONF_WIFI_M2M_SPI_BAUDRATE, 0);
 	
@@ -152,8 +152,10 @@ sint8 hif_chip_wake(void)
 	{
 		if(gstrHifCxt.u8ChipMode != M2M_NO_PS)
 		{
+			nm_bsp_wake_start();
 			ret = chip_wake();
 			if(ret != M2M_SUCCESS)goto ERR1;
+			nm_bsp_chip_awake(1);
 		}
 		else
 		{
@@ -232,6 +234,7 @@ sint8 hif_chip_sleep(void)
 		{
 			ret = chip_sleep();
 			if(ret != M2M_SUCCESS)goto ERR1;
+			nm_bsp_chip_awake(0);
 
 		}
 		else
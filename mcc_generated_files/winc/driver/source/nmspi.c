@@ -48,6 +48,9 @@
 
 #include "../../bus_wrapper/include/nm_bus_wrapper.h"
 #include "nmspi.h"
+#include "../../../drivers/timeout.h"
+#include "../../../time_service.h"
+#include "../../../config/IoT_Sensor_Node_config.h"
 
 #define NMI_PERIPH_REG_BASE 0x1000
 #define NMI_INTR_REG_BASE (NMI_PERIPH_REG_BASE+0xa00)
@@ -67,6 +70,7 @@
 #define NMI_SPI_MISC_CTRL (NMI_SPI_REG_BASE+0x48)
 
 #define NMI_SPI_PROTOCOL_OFFSET (NMI_SPI_PROTOCOL_CONFIG-NMI_SPI_REG_BASE)
+#define NMI_SPI_PROTOCOL_CRC	0xc		/* command CRC7 and data CRC16 checks */
 
 #define SPI_BASE                NMI_SPI_REG_BASE
 
@@ -96,7 +100,19 @@
 #define DATA_PKT_SZ_8K			(8 * 1024)
 #define DATA_PKT_SZ				DATA_PKT_SZ_8K
 
+/* CFG_WINC_SPI_CRC policies */
+#define SPI_CRC_OFF				0
+#define SPI_CRC_ON				1
+#define SPI_CRC_AUTO			2
+
+#define SPI_SELF_TEST_READS		16	/* chip id reads with CRC on, all alike, before it goes off */
+#define SPI_CRC_FALLBACK_ERRORS	3	/* bus errors with CRC off before it goes back on */
+
 static uint8 	gu8Crc_off	=   0;
+static uint8	gu8Crc16_checked = 0;	/* our data CRC16 matched the WINC's in the self-test */
+static uint8	gu8Crc_fallback = 0;	/* CRC off by the auto policy, may go back on */
+static uint8	gu8Crc_off_errors = 0;
+static tstrNmSpiStats gstrSpiStats;
 
 static sint8 nmi_spi_read(uint8* b, uint16 sz)
 {
@@ -179,6 +195,54 @@ static uint8 crc7(uint8 crc, const uint8 *buffer, uint32 len)
 	return crc;
 }
 
+/********************************************
+
+	Crc16 (ITU-T, x^16 + x^12 + x^5 + 1), for the data packets
+
+********************************************/
+
+static const uint16 crc16_table[256] PROGMEM = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+	0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+	0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+	0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+	0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+	0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+	0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+	0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+	0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+	0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+	0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+	0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+	0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+	0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+	0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+	0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+	0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+	0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+	0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+	0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+	0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+	0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+static uint16 crc16(uint16 crc, const uint8 *buffer, uint16 len)
+{
+	while (len--)
+		crc = (crc << 8) ^ pgm_read_word(&crc16_table[(uint8)(crc >> 8) ^ *buffer++]);
+	return crc;
+}
+
 /********************************************
 
 	Spi protocol Function
@@ -802,6 +866,14 @@ static sint8 spi_data_read(uint8 *b, uint16 sz,uint8 clockless)
 					result = N_FAIL;
 					break;
 				}
+				if ((((uint16)crc[0] << 8) | crc[1]) != crc16(0xffff, &b[ix], nbytes)) {
+					gstrSpiStats.u16Crc16Errors++;
+					if (gu8Crc16_checked) {
+						M2M_ERR("[nmi spi]: Failed data block crc check...\n");
+						result = N_FAIL;
+						break;
+					}
+				}
 			}
 		}
 		ix += nbytes;
@@ -865,6 +937,10 @@ static sint8 spi_data_write(uint8 *b, uint16 sz)
 			Write Crc
 		**/
 		if (!gu8Crc_off) {
+			uint16 u16Crc = crc16(0xffff, &b[ix], nbytes);
+
+			crc[0] = (uint8)(u16Crc >> 8);
+			crc[1] = (uint8)u16Crc;
 			if (M2M_SUCCESS != nmi_spi_write(crc, 2)) {
 				M2M_ERR("[nmi spi]: Failed data block crc write, bus error...\n");
 				result = N_FAIL;
@@ -892,6 +968,32 @@ static sint8 spi_data_write(uint8 *b, uint16 sz)
 
 ********************************************/
 
+static sint8 spi_read_reg(uint32 addr, uint32 *u32data);
+static sint8 spi_write_reg(uint32 addr, uint32 u32data);
+
+/*
+*	A transaction failed and the WINC SPI was reset, it is about to be retried.
+*	CRC the auto policy turned off goes back on after a few of these.
+*/
+static void spi_bus_error(void)
+{
+	uint32 reg;
+
+	gstrSpiStats.u16BusErrors++;
+	if (!gu8Crc_fallback || (++gu8Crc_off_errors < SPI_CRC_FALLBACK_ERRORS))
+		return;
+
+	gu8Crc_fallback = 0;	/* no nesting from the transactions below */
+	if (spi_read_reg(NMI_SPI_PROTOCOL_CONFIG, &reg) &&
+		spi_write_reg(NMI_SPI_PROTOCOL_CONFIG, reg | NMI_SPI_PROTOCOL_CRC)) {
+		gu8Crc_off = 0;
+		M2M_ERR("[nmi spi]: Bus errors, CRC back on\n");
+	} else {
+		gu8Crc_fallback = 1;
+	}
+	gu8Crc_off_errors = 0;
+}
+
 static sint8 spi_write_reg(uint32 addr, uint32 u32data)
 {
 	uint8 retry = SPI_RETRY_COUNT;
@@ -944,6 +1046,7 @@ _FAIL_:
 		spi_cmd_rsp(CMD_RESET);
 		M2M_ERR("Reset and retry %d %lx %lx\n",retry,addr,u32data);
 		nm_bsp_sleep(1);
+		spi_bus_error();
 		retry--;
 		if(retry) goto _RETRY_;
 	}
@@ -1011,6 +1114,7 @@ _FAIL_:
 		spi_cmd_rsp(CMD_RESET);
 		M2M_ERR("Reset and retry %d %lx %d\n",retry,addr,size);
 		nm_bsp_sleep(1);
+		spi_bus_error();
 		retry--;
 		if(retry) goto _RETRY_;
 	}
@@ -1085,6 +1189,7 @@ _FAIL_:
 		spi_cmd_rsp(CMD_RESET);
 		M2M_ERR("Reset and retry %d %lx\n",retry,addr);
 		nm_bsp_sleep(1);
+		spi_bus_error();
 		retry--;
 		if(retry) goto _RETRY_;
 	}
@@ -1157,6 +1262,7 @@ _FAIL_:
 		spi_cmd_rsp(CMD_RESET);
 		M2M_ERR("Reset and retry %d %lx %d\n",retry,addr,size);
 		nm_bsp_sleep(1);
+		spi_bus_error();
 		retry--;
 		if(retry) goto _RETRY_;
 	}
@@ -1190,6 +1296,38 @@ static void spi_init_pkt_sz(void)
 	nm_spi_write_reg(SPI_BASE+0x24, val32);
 }
 
+/*
+*	Called with CRC on: may it go off? The auto policy first reads the chip id
+*	SPI_SELF_TEST_READS times and wants the same value each time, with no bus
+*	error. These reads also tell if our data CRC16 matches the WINC's.
+*/
+static uint8 spi_crc_may_go_off(void)
+{
+#if CFG_WINC_SPI_CRC == SPI_CRC_OFF
+	return 1;
+#else
+	uint16 u16BusErrors = gstrSpiStats.u16BusErrors;
+	uint16 u16Crc16Errors = gstrSpiStats.u16Crc16Errors;
+	uint32 u32First, u32Chipid;
+	uint8 i;
+
+	if (!spi_read_reg(NMI_CHIPID, &u32First))
+		return 0;
+	for (i = 1; i < SPI_SELF_TEST_READS; i++) {
+		if (!spi_read_reg(NMI_CHIPID, &u32Chipid) || (u32Chipid != u32First)) {
+			M2M_ERR("[nmi spi]: Self test failed, CRC stays on\n");
+			return 0;
+		}
+	}
+	gu8Crc16_checked = (gstrSpiStats.u16Crc16Errors == u16Crc16Errors);
+	if (gstrSpiStats.u16BusErrors != u16BusErrors) {
+		M2M_ERR("[nmi spi]: Self test had bus errors, CRC stays on\n");
+		return 0;
+	}
+	return (CFG_WINC_SPI_CRC == SPI_CRC_AUTO);
+#endif
+}
+
 sint8 nm_spi_reset(void)
 {
 	spi_cmd(CMD_RESET, 0, 0, 0, 0);
@@ -1215,6 +1353,8 @@ sint8 nm_spi_init(void)
 		configure protocol
 	**/
 	gu8Crc_off = 0;
+	gu8Crc_fallback = 0;
+	gu8Crc_off_errors = 0;
 
 	// TODO: We can remove the CRC trials if there is a definite way to reset
 	// the SPI to it's initial value.
@@ -1229,9 +1369,9 @@ sint8 nm_spi_init(void)
 			return 0;
 		}
 	}
-	if(gu8Crc_off == 0)
+	if((gu8Crc_off == 0) && spi_crc_may_go_off())
 	{
-		reg &= ~0xc;	/* disable crc checking */
+		reg &= ~NMI_SPI_PROTOCOL_CRC;	/* disable crc checking */
 		reg &= ~0x70;
 		reg |= (0x5 << 4);
 		if (!spi_write_reg(NMI_SPI_PROTOCOL_CONFIG, reg)) {
@@ -1240,6 +1380,7 @@ sint8 nm_spi_init(void)
 		}
 		gu8Crc_off = 1;
 	}
+	gu8Crc_fallback = gu8Crc_off && (CFG_WINC_SPI_CRC == SPI_CRC_AUTO);
 
 	/**
 		make sure can read back chip id correctly
@@ -1267,9 +1408,23 @@ sint8 nm_spi_init(void)
 sint8 nm_spi_deinit(void)
 {
 	gu8Crc_off = 0;
+	gu8Crc_fallback = 0;
 	return M2M_SUCCESS;
 }
 
+static void spi_account(tstrNmSpiBlockStats *pstrStats, uint16 u16Sz, uint16 u16Ticks, uint16 u16Ms)
+{
+	uint16 u16Elapsed = timeout_getTime() - u16Ms;
+
+	/* The tick counter wraps every ~13 ms, longer blocks are timed by the scheduler */
+	if (u16Elapsed > SCHEDULER_BASE_PERIOD)
+		pstrStats->u32Us += timeout_toUs(u16Elapsed);
+	else
+		pstrStats->u32Us += (uint16)(TIME_getTicks() - u16Ticks) / TIME_TICKS_PER_US;
+	pstrStats->u32Bytes += u16Sz;
+	pstrStats->u16Blocks++;
+}
+
 /*
 *	@fn		nm_spi_read_reg
 *	@brief	Read register
@@ -1283,8 +1438,10 @@ sint8 nm_spi_deinit(void)
 uint32 nm_spi_read_reg(uint32 u32Addr)
 {
 	uint32 u32Val;
+	uint16 u16Ticks = TIME_getTicks();
+	uint16 u16Ms = timeout_getTime();
 
-	spi_read_reg(u32Addr, &u32Val);
+	if(N_OK == spi_read_reg(u32Addr, &u32Val)) spi_account(&gstrSpiStats.strReg, 4, u16Ticks, u16Ms);
 
 	return u32Val;
 }
@@ -1304,9 +1461,12 @@ uint32 nm_spi_read_reg(uint32 u32Addr)
 sint8 nm_spi_read_reg_with_ret(uint32 u32Addr, uint32* pu32RetVal)
 {
 	sint8 s8Ret;
+	uint16 u16Ticks = TIME_getTicks();
+	uint16 u16Ms = timeout_getTime();
 
 	s8Ret = spi_read_reg(u32Addr,pu32RetVal);
 
+	if(N_OK == s8Ret) spi_account(&gstrSpiStats.strReg, 4, u16Ticks, u16Ms);
 	if(N_OK == s8Ret) s8Ret = M2M_SUCCESS;
 	else s8Ret = M2M_ERR_BUS_FAIL;
 
@@ -1328,9 +1488,12 @@ sint8 nm_spi_read_reg_with_ret(uint32 u32Addr, uint32* pu32RetVal)
 sint8 nm_spi_write_reg(uint32 u32Addr, uint32 u32Val)
 {
 	sint8 s8Ret;
+	uint16 u16Ticks = TIME_getTicks();
+	uint16 u16Ms = timeout_getTime();
 
 	s8Ret = spi_write_reg(u32Addr, u32Val);
 
+	if(N_OK == s8Ret) spi_account(&gstrSpiStats.strReg, 4, u16Ticks, u16Ms);
 	if(N_OK == s8Ret) s8Ret = M2M_SUCCESS;
 	else s8Ret = M2M_ERR_BUS_FAIL;
 
@@ -1354,9 +1517,12 @@ sint8 nm_spi_write_reg(uint32 u32Addr, uint32 u32Val)
 sint8 nm_spi_read_block(uint32 u32Addr, uint8 *puBuf, uint16 u16Sz)
 {
 	sint8 s8Ret;
+	uint16 u16Ticks = TIME_getTicks();
+	uint16 u16Ms = timeout_getTime();
 
 	s8Ret = nm_spi_read(u32Addr, puBuf, u16Sz);
 
+	if(N_OK == s8Ret) spi_account(&gstrSpiStats.strRead, u16Sz, u16Ticks, u16Ms);
 	if(N_OK == s8Ret) s8Ret = M2M_SUCCESS;
 	else s8Ret = M2M_ERR_BUS_FAIL;
 
@@ -1380,13 +1546,35 @@ sint8 nm_spi_read_block(uint32 u32Addr, uint8 *puBuf, uint16 u16Sz)
 sint8 nm_spi_write_block(uint32 u32Addr, uint8 *puBuf, uint16 u16Sz)
 {
 	sint8 s8Ret;
+	uint16 u16Ticks = TIME_getTicks();
+	uint16 u16Ms = timeout_getTime();
 
 	s8Ret = nm_spi_write(u32Addr, puBuf, u16Sz);
 
+	if(N_OK == s8Ret) spi_account(&gstrSpiStats.strWrite, u16Sz, u16Ticks, u16Ms);
 	if(N_OK == s8Ret) s8Ret = M2M_SUCCESS;
 	else s8Ret = M2M_ERR_BUS_FAIL;
 
 	return s8Ret;
 }
 
+/*
+*	@fn		nm_spi_get_stats
+*	@brief	Block transfers so far, for the HIF throughput
+*	@return	Read and write totals
+*/
+const tstrNmSpiStats *nm_spi_get_stats(void)
+{
+	return &gstrSpiStats;
+}
+
+/*
+*	@fn		nm_spi_is_crc_on
+*	@brief	Commands and data are CRC protected, see CFG_WINC_SPI_CRC
+*/
+uint8 nm_spi_is_crc_on(void)
+{
+	return !gu8Crc_off;
+}
+
 #endif
@@ -44,6 +44,24 @@
 
 #include "../../common/include/nm_common.h"
 
+/**
+*	@struct	tstrNmSpiBlockStats
+*	@brief	Successful transfers, throughput in bytes/s = u32Bytes * 1000000 / u32Us
+*/
+typedef struct {
+	uint32 u32Bytes;
+	uint32 u32Us;	/* from the command to the last data byte, CRC and retries included */
+	uint16 u16Blocks;
+} tstrNmSpiBlockStats;
+
+typedef struct {
+	tstrNmSpiBlockStats strRead;	/* nm_spi_read_block */
+	tstrNmSpiBlockStats strWrite;	/* nm_spi_write_block */
+	tstrNmSpiBlockStats strReg;		/* register reads and writes, u16Blocks wraps */
+	uint16 u16BusErrors;			/* transactions reset and retried */
+	uint16 u16Crc16Errors;			/* data CRC16 mismatches, with CRC on */
+} tstrNmSpiStats;
+
 #ifdef __cplusplus
      extern "C" {
 #endif
@@ -125,6 +143,19 @@ sint8 nm_spi_read_block(uint32 u32Addr, uint8 *puBuf, uint16 u16Sz);
 */
 sint8 nm_spi_write_block(uint32 u32Addr, uint8 *puBuf, uint16 u16Sz);
 
+/**
+*	@fn		nm_spi_get_stats
+*	@brief	Block transfers so far, for the HIF throughput
+*	@return	Read and write totals
+*/
+const tstrNmSpiStats *nm_spi_get_stats(void);
+
+/**
+*	@fn		nm_spi_is_crc_on
+*	@brief	Commands and data are CRC protected, see CFG_WINC_SPI_CRC
+*/
+uint8 nm_spi_is_crc_on(void);
+
 #ifdef __cplusplus
 	 }
 #endif
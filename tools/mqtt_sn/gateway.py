@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Stand-in MQTT-SN gateway, to try the firmware MQTT-SN client (mqtt_sn.h) on a PC.
+
+Answers what the client sends (CONNECT, PUBLISH, PINGREQ, DISCONNECT) the way
+an MQTT-SN v1.2 gateway would, and prints each publish instead of forwarding
+it to a broker:
+    <time> <client address> topic <id> qos <qos> [dup] <payload>
+with the payload as text if it is, in hex otherwise (decode delta batches with
+../telemetry_codec/decode.py).
+
+    ./gateway.py [--port 10000] [--topics 1,2] [--drop 0.2]
+
+--topics lists the predefined topic ids, QoS 1 publishes to others are
+rejected (PUBACK "invalid topic id"); --drop ignores that share of the
+datagrams, to exercise the client retries.
+"""
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import time
+
+CONNECT = 0x04
+CONNACK = 0x05
+PUBLISH = 0x0C
+PUBACK = 0x0D
+PINGREQ = 0x16
+PINGRESP = 0x17
+DISCONNECT = 0x18
+
+ACCEPTED = 0x00
+INVALID_TOPIC_ID = 0x02
+
+FLAG_DUP = 0x80
+
+
+def message(kind, body=b""):
+    if len(body) + 2 <= 255:
+        return bytes([len(body) + 2, kind]) + body
+    return struct.pack(">BHB", 1, len(body) + 4, kind) + body
+
+
+def split(datagram):
+    """(type, body) of a datagram, None if its length field does not match."""
+    if len(datagram) >= 4 and datagram[0] == 1:
+        length, offset = struct.unpack(">H", datagram[1:3])[0], 3
+    elif len(datagram) >= 2:
+        length, offset = datagram[0], 1
+    else:
+        return None
+    if length != len(datagram):
+        return None
+    return datagram[offset], datagram[offset + 1:]
+
+
+def show(payload):
+    try:
+        text = payload.decode("utf-8")
+        if text.isprintable():
+            return text
+    except UnicodeDecodeError:
+        pass
+    return payload.hex()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=10000)
+    parser.add_argument("--topics", default="", help="predefined topic ids, e.g. 1,2 (default: any)")
+    parser.add_argument("--drop", type=float, default=0.0, help="share of the datagrams ignored")
+    args = parser.parse_args()
+    topics = {int(t) for t in args.topics.split(",") if t}
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", args.port))
+    print("MQTT-SN gateway stand-in on UDP port %d" % args.port, file=sys.stderr)
+
+    while True:
+        datagram, client = sock.recvfrom(2048)
+        if random.random() < args.drop:
+            continue
+        parsed = split(datagram)
+        if parsed is None:
+            print("%s malformed %s" % (client[0], datagram.hex()), file=sys.stderr)
+            continue
+        kind, body = parsed
+        stamp = time.strftime("%H:%M:%S")
+
+        if kind == CONNECT and len(body) >= 4:
+            duration = struct.unpack(">H", body[2:4])[0]
+            print("%s %s connect %s keep alive %ds" % (stamp, client[0], body[4:].decode(errors="replace"), duration))
+            sock.sendto(message(CONNACK, bytes([ACCEPTED])), client)
+        elif kind == PUBLISH and len(body) >= 5:
+            flags = body[0]
+            topic, message_id = struct.unpack(">HH", body[1:5])
+            qos = (flags >> 5) & 3
+            qos = -1 if qos == 3 else qos
+            print("%s %s topic %d qos %d%s %s" % (stamp, client[0], topic, qos,
+                                                 " dup" if flags & FLAG_DUP else "", show(body[5:])))
+            if qos == 1:
+                code = ACCEPTED if not topics or topic in topics else INVALID_TOPIC_ID
+                sock.sendto(message(PUBACK, struct.pack(">HHB", topic, message_id, code)), client)
+        elif kind == PINGREQ:
+            sock.sendto(message(PINGRESP), client)
+        elif kind == DISCONNECT:
+            print("%s %s disconnect" % (stamp, client[0]))
+            sock.sendto(message(DISCONNECT), client)
+        else:
+            print("%s %s type 0x%02x ignored" % (stamp, client[0], kind), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
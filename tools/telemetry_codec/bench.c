@@ -0,0 +1,268 @@
+/*
+    \file   bench.c
+
+    \brief  Host benchmark of the delta batch encoding.
+
+    Reads a trace, a CSV of samples as the streams take them:
+        ms,Light,Temp           header: the channel names (up to 8)
+        0,812,2456              monotonic ms, then the values in fixed point
+        1000,815,2456
+    and cuts it in batches of up to 30 samples (CFG_BATCH_SAMPLES). For each
+    batch it measures the JSON payload (the firmware formatBatch() layout, with
+    the values written as integers), the delta payload and the delta + LZ
+    payload, and times the delta and LZ encoders.
+
+    The timings are those of the host: the encoders are plain C, run them on
+    the target for the MCU figures.
+
+    Build, from this directory:
+        cc -O2 -I../../mcc_generated_files -o bench bench.c ../../mcc_generated_files/utils/delta_codec.c
+    Run:
+        ./bench trace.csv               statistics
+        ./bench -x trace.csv            the payloads in hex, for decode.py
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "utils/delta_codec.h"
+
+#define MAX_CHANNELS    8
+#define MAX_SAMPLES     30
+#define PAYLOAD_MAX     1024
+#define LINE_MAX_CHARS  256
+#define REPEAT          200
+
+#define TELEMETRY_DELTA_BATCH       0xD0
+#define TELEMETRY_DELTA_BATCH_LZ    0xD1
+
+typedef struct
+{
+   char names[MAX_CHANNELS][32];
+   uint8_t channelCount;
+   uint32_t ms[MAX_SAMPLES];
+   int32_t values[MAX_SAMPLES][MAX_CHANNELS];
+   uint8_t count;
+} batch_t;
+
+typedef struct
+{
+   uint32_t batches;
+   uint32_t samples;
+   uint32_t jsonBytes;
+   uint32_t deltaBytes;
+   uint32_t lzBytes;
+   double deltaNs;
+   double lzNs;
+} totals_t;
+
+static double nowNs(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// {"t0":<unix seconds>,"dt":[...],"<name>":[...]...}
+static uint32_t jsonLength(const batch_t *batch)
+{
+   char text[32];
+   uint32_t length = snprintf(text, sizeof(text), "{\"t0\":%u,\"dt\":[", 1600000000U) + 2;
+   uint8_t ch;
+   uint8_t i;
+
+   for (i = 0; i < batch->count; i++)
+   {
+      length += snprintf(text, sizeof(text), "%u", batch->ms[i] - batch->ms[0]) + (i ? 1 : 0);
+   }
+   for (ch = 0; ch < batch->channelCount; ch++)
+   {
+      length += strlen(batch->names[ch]) + 6;
+      for (i = 0; i < batch->count; i++)
+      {
+         length += snprintf(text, sizeof(text), "%d", batch->values[i][ch]) + (i ? 1 : 0);
+      }
+   }
+   return length;
+}
+
+// The firmware deltaBatch() layout
+static uint16_t deltaBatch(const batch_t *batch, uint8_t *buffer, uint16_t size)
+{
+   deltaWriter_t writer;
+   deltaSeries_t series;
+   uint8_t ch;
+   uint8_t i;
+
+   DELTA_init(&writer, buffer, size);
+   DELTA_putByte(&writer, TELEMETRY_DELTA_BATCH);
+   DELTA_putUvarint(&writer, 1600000000U);
+   DELTA_putUvarint(&writer, batch->count);
+   DELTA_putUvarint(&writer, batch->channelCount);
+   for (ch = 0; ch < batch->channelCount; ch++)
+   {
+      DELTA_putText(&writer, batch->names[ch]);
+      DELTA_putByte(&writer, 0);
+   }
+   DELTA_beginSeries(&series, &writer);
+   for (i = 0; i < batch->count; i++)
+   {
+      DELTA_putTime(&series, batch->ms[i] - batch->ms[0]);
+   }
+   for (ch = 0; ch < batch->channelCount; ch++)
+   {
+      DELTA_beginSeries(&series, &writer);
+      for (i = 0; i < batch->count; i++)
+      {
+         DELTA_putValue(&series, batch->values[i][ch]);
+      }
+   }
+   return DELTA_length(&writer);
+}
+
+static void printHex(const uint8_t *data, uint16_t length)
+{
+   while (length--)
+   {
+      printf("%02x", *data++);
+   }
+   printf("\n");
+}
+
+static void runBatch(const batch_t *batch, totals_t *totals, bool dump)
+{
+   uint8_t delta[PAYLOAD_MAX];
+   uint8_t lz[PAYLOAD_MAX];
+   uint16_t deltaLength = 0;
+   uint16_t lzLength = 0;
+   double start;
+   int i;
+
+   start = nowNs();
+   for (i = 0; i < REPEAT; i++)
+   {
+      deltaLength = deltaBatch(batch, delta, sizeof(delta));
+   }
+   totals->deltaNs += (nowNs() - start) / REPEAT;
+   start = nowNs();
+   for (i = 0; i < REPEAT; i++)
+   {
+      lzLength = DELTA_compress(delta + 1, deltaLength - 1, lz + 1, sizeof(lz) - 1);
+   }
+   totals->lzNs += (nowNs() - start) / REPEAT;
+   // As the firmware does: LZ only when it helps
+   if (lzLength)
+   {
+      lz[0] = TELEMETRY_DELTA_BATCH_LZ;
+      lzLength++;
+   }
+   else
+   {
+      memcpy(lz, delta, deltaLength);
+      lzLength = deltaLength;
+   }
+
+   totals->batches++;
+   totals->samples += batch->count;
+   totals->jsonBytes += jsonLength(batch);
+   totals->deltaBytes += deltaLength;
+   totals->lzBytes += lzLength;
+   if (dump)
+   {
+      printHex(delta, deltaLength);
+      printHex(lz, lzLength);
+   }
+}
+
+static bool parseHeader(char *line, batch_t *batch)
+{
+   char *field = strtok(line, ",\r\n");
+
+   batch->channelCount = 0;
+   while ((field = strtok(NULL, ",\r\n")) != NULL)
+   {
+      if (batch->channelCount == MAX_CHANNELS)
+      {
+         return false;
+      }
+      snprintf(batch->names[batch->channelCount++], sizeof(batch->names[0]), "%s", field);
+   }
+   return (batch->channelCount > 0);
+}
+
+static bool parseSample(char *line, batch_t *batch)
+{
+   char *end;
+   uint8_t ch;
+
+   batch->ms[batch->count] = strtoul(line, &end, 10);
+   for (ch = 0; ch < batch->channelCount; ch++)
+   {
+      if (*end != ',')
+      {
+         return false;
+      }
+      batch->values[batch->count][ch] = strtol(end + 1, &end, 10);
+   }
+   batch->count++;
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   static batch_t batch;
+   totals_t totals = {0};
+   char line[LINE_MAX_CHARS];
+   bool dump = (argc == 3) && (strcmp(argv[1], "-x") == 0);
+   FILE *trace;
+   uint32_t lineNumber = 1;
+
+   if ((argc != 2) && !dump)
+   {
+      fprintf(stderr, "usage: %s [-x] trace.csv\n", argv[0]);
+      return 2;
+   }
+   trace = fopen(argv[argc - 1], "r");
+   if ((trace == NULL) || (fgets(line, sizeof(line), trace) == NULL) || !parseHeader(line, &batch))
+   {
+      fprintf(stderr, "%s: no trace header\n", argv[argc - 1]);
+      return 1;
+   }
+   while (fgets(line, sizeof(line), trace) != NULL)
+   {
+      lineNumber++;
+      if (!parseSample(line, &batch))
+      {
+         fprintf(stderr, "%s:%u: malformed sample\n", argv[argc - 1], lineNumber);
+         return 1;
+      }
+      if (batch.count == MAX_SAMPLES)
+      {
+         runBatch(&batch, &totals, dump);
+         batch.count = 0;
+      }
+   }
+   if (batch.count)
+   {
+      runBatch(&batch, &totals, dump);
+   }
+   fclose(trace);
+   if (dump || (totals.samples == 0))
+   {
+      return 0;
+   }
+
+   printf("%u samples of %u channels in %u batches\n", totals.samples, batch.channelCount, totals.batches);
+   printf("JSON    %6u bytes  %5.1f bytes/sample\n", totals.jsonBytes, (double)totals.jsonBytes / totals.samples);
+   printf("delta   %6u bytes  %5.1f bytes/sample  ratio %4.1f  %6.1f ns/sample\n", totals.deltaBytes,
+          (double)totals.deltaBytes / totals.samples, (double)totals.jsonBytes / totals.deltaBytes,
+          totals.deltaNs / totals.samples);
+   printf("delta+LZ %5u bytes  %5.1f bytes/sample  ratio %4.1f  %6.1f ns/sample (LZ pass)\n", totals.lzBytes,
+          (double)totals.lzBytes / totals.samples, (double)totals.jsonBytes / totals.lzBytes,
+          totals.lzNs / totals.samples);
+   return 0;
+}
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Decoder of the TELEMETRY_ENCODING_DELTA batches (see telemetry.h).
+
+decode(payload) returns the same document as a JSON batch:
+    {"t0": <unix seconds>, "dt": [<ms from t0>, ...], "<name>": [<value>, ...], ...}
+with the values scaled by their decimals. Payloads not starting with a delta
+batch type byte are CBOR (decode them with a CBOR library).
+
+Command line: one payload per line, in hex, on stdin; one JSON document per
+line on stdout.
+"""
+
+import json
+import sys
+
+DELTA_BATCH = 0xD0
+DELTA_BATCH_LZ = 0xD1
+
+LZ_MIN_MATCH = 2
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.position = 0
+
+    def byte(self):
+        if self.position >= len(self.data):
+            raise ValueError("truncated payload")
+        value = self.data[self.position]
+        self.position += 1
+        return value
+
+    def uvarint(self):
+        value = 0
+        shift = 0
+        while True:
+            byte = self.byte()
+            value |= (byte & 0x7F) << shift
+            if byte < 0x80:
+                return value
+            shift += 7
+            if shift > 35:
+                raise ValueError("varint too long")
+
+    def varint(self):
+        value = self.uvarint()
+        return (value >> 1) ^ -(value & 1)
+
+    def text(self):
+        length = self.uvarint()
+        start = self.position
+        self.position += length
+        if self.position > len(self.data):
+            raise ValueError("truncated payload")
+        return self.data[start:self.position].decode("utf-8")
+
+
+def decompress(data):
+    """Inverse of DELTA_compress() (utils/delta_codec.c)."""
+    out = bytearray()
+    bits = len(data) * 8
+    position = 0
+
+    def take(count):
+        nonlocal position
+        value = 0
+        for _ in range(count):
+            value = (value << 1) | ((data[position >> 3] >> (7 - (position & 7))) & 1)
+            position += 1
+        return value
+
+    # Fewer than 9 bits left is the padding of the last byte
+    while bits - position >= 9:
+        if take(1):
+            out.append(take(8))
+            continue
+        if bits - position < 12:
+            break
+        offset = take(8) + 1
+        length = take(4) + LZ_MIN_MATCH
+        if offset > len(out):
+            raise ValueError("back reference before the start")
+        for _ in range(length):
+            out.append(out[-offset])
+    return bytes(out)
+
+
+def scale(value, decimals):
+    return value / 10 ** decimals if decimals else value
+
+
+def decode(payload):
+    payload = bytes(payload)
+    if not payload or payload[0] not in (DELTA_BATCH, DELTA_BATCH_LZ):
+        raise ValueError("not a delta batch")
+    body = decompress(payload[1:]) if payload[0] == DELTA_BATCH_LZ else payload[1:]
+    reader = Reader(body)
+
+    document = {"t0": reader.uvarint()}
+    count = reader.uvarint()
+    channels = []
+    for _ in range(reader.uvarint()):
+        name = reader.text()
+        channels.append((name, reader.byte()))
+
+    dt = []
+    delta = 0
+    for i in range(count):
+        if i == 0:
+            dt.append(reader.uvarint())
+        elif i == 1:
+            delta = reader.uvarint()
+            dt.append(dt[-1] + delta)
+        else:
+            delta += reader.varint()
+            dt.append(dt[-1] + delta)
+    document["dt"] = dt
+
+    for name, decimals in channels:
+        values = []
+        value = 0
+        for _ in range(count):
+            value += reader.varint()
+            values.append(scale(value, decimals))
+        document[name] = values
+    return document
+
+
+def main():
+    for line in sys.stdin:
+        line = line.strip()
+        if line:
+            print(json.dumps(decode(bytes.fromhex(line)), separators=(",", ":")))
+
+
+if __name__ == "__main__":
+    main()